@@ -0,0 +1,162 @@
+#include <string.h>
+#include "utils.h"
+
+TEST_CASE("buddy allocator", "[buddy]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  const size_t range_size = 64 * 1024;
+  char* range = (char*)frag_alloc_aligned(system, range_size, 4096);
+  memset(range, 0xcd, range_size);
+  frag_allocator_t* allocator = frag_buddy_allocator_create(system, "buddy", true, range, range_size, 64);
+  DEFER([&] {
+    frag_allocator_destroy(system, allocator);
+    frag_free(system, range);
+  });
+
+  SECTION("it can allocate properly aligned memory") {
+    void* ptr = frag_alloc_aligned(allocator, 16, 1024);
+    REQUIRE(is_aligned_ptr(ptr, 1024));
+    frag_free(allocator, ptr);
+  }
+
+  SECTION("it hands out pointers inside the range") {
+    char* ptr = (char*)frag_alloc(allocator, 100);
+    CHECK(ptr >= range);
+    CHECK(ptr + 100 <= range + range_size);
+    frag_free(allocator, ptr);
+  }
+
+  SECTION("it rounds allocations up to a power of 2") {
+    frag_allocator_stats_t stats;
+    void* ptr = frag_alloc(allocator, 100);
+    frag_allocator_stats(allocator, &stats);
+    CHECK(stats.bytes == 128);
+    frag_free(allocator, ptr);
+  }
+
+  SECTION("it never touches the managed memory") {
+    void* ptr1 = frag_alloc(allocator, 100);
+    void* ptr2 = frag_alloc(allocator, 5000);
+    void* ptr3 = frag_alloc(allocator, 64);
+    frag_free(allocator, ptr2);
+    frag_free(allocator, ptr1);
+    frag_free(allocator, ptr3);
+    bool untouched = true;
+    for (size_t index = 0; index < range_size; ++index) {
+      untouched = untouched && range[index] == (char)0xcd;
+    }
+    CHECK(untouched);
+  }
+
+  SECTION("it coalesces freed blocks") {
+    void* ptrs[range_size / 64];
+    for (size_t index = 0; index < range_size / 64; ++index) {
+      ptrs[index] = frag_alloc(allocator, 64);
+      REQUIRE(ptrs[index] != nullptr);
+    }
+    for (size_t index = 0; index < range_size / 64; ++index) {
+      frag_free(allocator, ptrs[(index * 7) % (range_size / 64)]);
+    }
+    void* ptr = frag_alloc(allocator, range_size);
+    CHECK(ptr == range);
+    frag_free(allocator, ptr);
+  }
+
+  SECTION("it fails when the range is exhausted") {
+    void* ptr = frag_alloc(allocator, range_size / 2 + 1);
+    CHECK_THROWS(frag_alloc(allocator, 1));
+    frag_free(allocator, ptr);
+  }
+
+  SECTION("it asserts when freeing an invalid pointer") {
+    char* ptr = (char*)frag_alloc(allocator, 128);
+    CHECK_THROWS(frag_free(allocator, ptr + 64));
+    frag_free(allocator, ptr);
+  }
+
+  SECTION("it frees blocks by size") {
+    void* ptr1 = frag_alloc(allocator, 100);
+    void* ptr2 = frag_alloc_aligned(allocator, 16, 1024);
+    frag_free_sized(allocator, ptr1, 100);
+    frag_free_sized_ex(allocator, ptr2, 16, 1024, __FILE__, __LINE__, __func__);
+
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(allocator, &stats);
+    CHECK(stats.count == 0);
+    CHECK(stats.bytes == 0);
+    void* ptr3 = frag_alloc(allocator, range_size);
+    CHECK(ptr3 != NULL);
+    frag_free(allocator, ptr3);
+  }
+
+  SECTION("it asserts when freeing with the wrong size") {
+    void* ptr = frag_alloc(allocator, 100);
+    CHECK_THROWS(frag_free_sized(allocator, ptr, 1000));
+    CHECK_THROWS(frag_free_sized(allocator, ptr, 10));
+    frag_free_sized(allocator, ptr, 100);
+  }
+}
+
+TEST_CASE("buddy allocator handles ranges that aren't a power of 2", "[buddy]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  char range[3 * 1024];
+  frag_allocator_t* allocator = frag_buddy_allocator_create(system, "buddy", true, range, sizeof(range), 256);
+  DEFER([&] {
+    frag_allocator_destroy(system, allocator);
+  });
+
+  SECTION("it uses the whole range and nothing past it") {
+    char* ptr1 = (char*)frag_alloc_aligned(allocator, 2048, 1);
+    char* ptr2 = (char*)frag_alloc_aligned(allocator, 1024, 1);
+    CHECK(ptr2 + 1024 <= range + sizeof(range));
+    CHECK_THROWS(frag_alloc_aligned(allocator, 256, 1));
+    frag_free(allocator, ptr2);
+    frag_free(allocator, ptr1);
+  }
+}
+
+TEST_CASE("buddy allocator detects memory leaks", "[buddy]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  alignas(64) char range[4096];
+  frag_allocator_t* allocator = frag_buddy_allocator_create(system, "buddy", true, range, sizeof(range), 64);
+  DEFER([&] {
+    frag_allocator_destroy(system, allocator);
+  });
+
+  SECTION("it detects memory leaks on shutdown") {
+    void* ptr = frag_alloc_aligned(allocator, 16, 32);
+    CHECK_THROWS(frag_allocator_destroy(system, allocator));
+    frag_free(allocator, ptr);
+  }
+}
+
+static void ignore_out_of_memory(const frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func) {
+}
+
+TEST_CASE("buddy allocator handles running out of memory for its table", "[buddy]") {
+  frag_config_t config;
+  frag_config_init(&config);
+  config.report_out_of_memory = &ignore_out_of_memory;
+  init_t init(&config);
+  frag_allocator_t* system = frag_system_allocator();
+
+  // room for the allocator but not its table
+  char buf[1024];
+  frag_allocator_t* owner = frag_fixed_stack_allocator_create(system, "owner", true, buf, sizeof(buf));
+  DEFER([&] {
+    frag_allocator_destroy(system, owner);
+  });
+
+  SECTION("it returns null and frees the allocator") {
+    alignas(64) static char range[64 * 1024];
+    CHECK(frag_buddy_allocator_create(owner, "buddy", true, range, sizeof(range), 64) == NULL);
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(owner, &stats);
+    CHECK(stats.count == 0);
+  }
+}
@@ -0,0 +1,234 @@
+#include <string>
+#include "frag_containers.h"
+#include "utils.h"
+
+struct tracked_t {
+  tracked_t()
+  : value(0) {
+    ++s_live;
+  }
+
+  tracked_t(int in_value)
+  : value(in_value) {
+    ++s_live;
+  }
+
+  tracked_t(tracked_t&& other)
+  : value(other.value) {
+    ++s_live;
+    ++s_moves;
+  }
+
+  tracked_t& operator=(tracked_t&& other) {
+    value = other.value;
+    return *this;
+  }
+
+  ~tracked_t() {
+    --s_live;
+  }
+
+  int value;
+
+  static int s_live;
+  static int s_moves;
+};
+
+int tracked_t::s_live = 0;
+int tracked_t::s_moves = 0;
+
+TEST_CASE("resize", "[containers]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  const size_t buf_size = 1024;
+  char buf[buf_size];
+  frag_allocator_t* allocator = frag_fixed_stack_allocator_create(system, "woot", true, buf, buf_size);
+  DEFER([&] {
+    frag_allocator_destroy(system, allocator);
+  });
+
+  SECTION("it grows and shrinks the top of a stack in place") {
+    void* ptr = frag_alloc(allocator, 16);
+    CHECK(frag_usable_size(allocator, ptr) == 16);
+    frag_allocator_stats_t before;
+    frag_allocator_stats(allocator, &before);
+
+    CHECK(frag_resize(allocator, ptr, 256));
+    CHECK(frag_usable_size(allocator, ptr) == 256);
+    frag_allocator_stats_t after;
+    frag_allocator_stats(allocator, &after);
+    CHECK(after.bytes == before.bytes + 240);
+    CHECK(after.count == before.count);
+
+    CHECK(frag_resize(allocator, ptr, 8));
+    CHECK(frag_usable_size(allocator, ptr) == 8);
+    frag_free(allocator, ptr);
+  }
+
+  SECTION("it refuses to resize something that isn't on top") {
+    void* ptr1 = frag_alloc(allocator, 16);
+    void* ptr2 = frag_alloc(allocator, 16);
+    CHECK_FALSE(frag_resize(allocator, ptr1, 32));
+    CHECK(frag_usable_size(allocator, ptr1) == 16);
+    frag_free(allocator, ptr2);
+    frag_free(allocator, ptr1);
+  }
+
+  SECTION("it refuses to grow past the end of the buffer") {
+    void* ptr = frag_alloc(allocator, 16);
+    CHECK_FALSE(frag_resize(allocator, ptr, buf_size));
+    frag_free(allocator, ptr);
+  }
+
+  SECTION("realloc grows in place when it can") {
+    char* ptr = (char*)frag_alloc(allocator, 16);
+    memset(ptr, 7, 16);
+    char* ptr_new = (char*)frag_realloc(allocator, ptr, 512);
+    CHECK(ptr_new == ptr);
+    CHECK(ptr_new[15] == 7);
+    frag_free(allocator, ptr_new);
+  }
+
+  SECTION("realloc leaves the original alone when it fails") {
+    void* ptr1 = frag_alloc(allocator, 16);
+    void* ptr2 = frag_alloc(allocator, 16);
+    CHECK_THROWS(frag_realloc(allocator, ptr1, buf_size));
+    CHECK(frag_usable_size(allocator, ptr1) == 16);
+    frag_free(allocator, ptr2);
+    frag_free(allocator, ptr1);
+  }
+}
+
+TEST_CASE("vector", "[containers]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+  frag_allocator_t* allocator = frag_vm_stack_allocator_create(system, "woot", true, 1024 * 1024, 0);
+  DEFER([&] {
+    frag_allocator_destroy(system, allocator);
+  });
+
+  SECTION("it grows in place when the allocator can extend the block") {
+    frag::vector<int> values(allocator);
+    values.push_back(0);
+    const int* data = values.data();
+    for (int index = 1; index < 10000; ++index) {
+      REQUIRE(values.push_back(index));
+    }
+    CHECK(values.data() == data);
+    CHECK(values.size() == 10000);
+    for (int index = 0; index < 10000; ++index) {
+      REQUIRE(values[index] == index);
+    }
+  }
+
+  SECTION("it charges its storage to the allocator") {
+    frag::vector<int> values(allocator);
+    values.reserve(100);
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(allocator, &stats);
+    CHECK(stats.count == 1);
+    CHECK(stats.bytes >= 100 * sizeof(int));
+  }
+
+  SECTION("it uses the usable size as its capacity") {
+    frag::vector<char> values(allocator);
+    values.push_back('a');
+    CHECK(values.capacity() == frag_usable_size(allocator, values.data()));
+  }
+}
+
+TEST_CASE("vector falls back to moving", "[containers]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  SECTION("it moves elements that can't be relocated") {
+    frag::vector<tracked_t> values(system);
+    tracked_t::s_moves = 0;
+    for (int index = 1; index <= 100; ++index) {
+      REQUIRE(values.emplace_back(index) != nullptr);
+    }
+    CHECK(tracked_t::s_moves > 0);
+    CHECK(tracked_t::s_live == 100);
+    CHECK(values.back().value == 100);
+    values.clear();
+    CHECK(tracked_t::s_live == 0);
+  }
+
+  SECTION("it reallocates elements that can be relocated") {
+    frag::vector<int> values(system);
+    for (int index = 0; index < 10000; ++index) {
+      REQUIRE(values.push_back(index));
+    }
+    int sum = 0;
+    for (int value : values) {
+      sum += value;
+    }
+    CHECK(sum == 10000 * 9999 / 2);
+    values.resize(10);
+    values.shrink_to_fit();
+    CHECK(values.size() == 10);
+    CHECK(values.capacity() >= 10);
+  }
+
+  SECTION("it can append one of its own elements while growing") {
+    frag::vector<std::string> values(system);
+    REQUIRE(values.push_back(std::string(100, 'x')));
+    for (int index = 0; index < 100; ++index) {
+      REQUIRE(values.push_back(values[0]));
+      REQUIRE(values.push_back(values.back()));
+    }
+    CHECK(values.size() == 201);
+    for (const std::string& value : values) {
+      CHECK(value == std::string(100, 'x'));
+    }
+  }
+}
+
+TEST_CASE("hash_map", "[containers]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+  frag::hash_map<int, int> map(system);
+
+  SECTION("it finds what was inserted") {
+    for (int index = 0; index < 1000; ++index) {
+      REQUIRE(map.emplace(index, index * 2) != nullptr);
+    }
+    CHECK(map.size() == 1000);
+    for (int index = 0; index < 1000; ++index) {
+      const int* value = map.find(index);
+      REQUIRE(value != nullptr);
+      REQUIRE(*value == index * 2);
+    }
+    CHECK(map.find(1000) == nullptr);
+  }
+
+  SECTION("it doesn't overwrite on emplace") {
+    map.emplace(1, 10);
+    CHECK(*map.emplace(1, 20) == 10);
+    map.insert_or_assign(1, 30);
+    CHECK(*map.find(1) == 30);
+    CHECK(map.size() == 1);
+  }
+
+  SECTION("it erases") {
+    for (int index = 0; index < 1000; ++index) {
+      map.emplace(index, index);
+    }
+    for (int index = 0; index < 1000; index += 2) {
+      REQUIRE(map.erase(index));
+    }
+    CHECK_FALSE(map.erase(0));
+    CHECK(map.size() == 500);
+    for (int index = 0; index < 1000; ++index) {
+      const int* value = map.find(index);
+      if (index % 2 == 0) {
+        REQUIRE(value == nullptr);
+      }
+      else {
+        REQUIRE(value != nullptr);
+        REQUIRE(*value == index);
+      }
+    }
+  }
+}
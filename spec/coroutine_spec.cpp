@@ -0,0 +1,124 @@
+#include "utils.h"
+
+TEST_CASE("coroutine frame pool", "[coroutine]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  SECTION("it reuses frames of the same size class") {
+    void* ptr1 = frag_coroutine_frame_alloc(100);
+    frag_coroutine_frame_free(ptr1, 100);
+    void* ptr2 = frag_coroutine_frame_alloc(120);
+    CHECK(ptr2 == ptr1);
+    frag_coroutine_frame_free(ptr2, 120);
+  }
+
+  SECTION("it keeps freed frames allocated until trimmed") {
+    frag_allocator_stats_t before;
+    frag_allocator_stats(system, &before);
+    void* ptr = frag_coroutine_frame_alloc(100);
+    frag_coroutine_frame_free(ptr, 100);
+
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(system, &stats);
+    CHECK(stats.count == before.count + 1);
+    CHECK(frag_coroutine_frame_pool_trim() == 128);
+    frag_allocator_stats(system, &stats);
+    CHECK(stats.count == before.count);
+  }
+
+  SECTION("it passes big frames straight through") {
+    void* ptr = frag_coroutine_frame_alloc(64 * 1024);
+    CHECK(ptr != NULL);
+    frag_coroutine_frame_free(ptr, 64 * 1024);
+    CHECK(frag_coroutine_frame_pool_trim() == 0);
+  }
+}
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+#include "frag_coroutine.h"
+
+struct handler_a_t {};
+struct handler_b_t {};
+
+static frag::task<int, handler_a_t> add(frag_allocator_t* allocator, int a, int b) {
+  co_return a + b;
+}
+
+static frag::task<int, handler_a_t> add_later(int a, int b, frag_allocator_t* allocator) {
+  co_return a + b;
+}
+
+static frag::task<int, handler_b_t> add_pooled(int a, int b) {
+  co_return a + b;
+}
+
+static frag::task<int, handler_b_t> sum_pooled(int count) {
+  int total = 0;
+  for (int index = 0; index < count; ++index) {
+    total += co_await add_pooled(index, 1);
+  }
+  co_return total;
+}
+
+static frag::task<void, handler_b_t> fail() {
+  throw 7;
+  co_return;
+}
+
+TEST_CASE("coroutine tasks", "[coroutine]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+  frag_allocator_t* allocator = frag_group_allocator_create(system, "handlers", true, system);
+  DEFER([&] {
+    frag_allocator_destroy(system, allocator);
+  });
+
+  SECTION("it allocates the frame from the allocator argument") {
+    frag::task<int, handler_a_t> task = add(allocator, 1, 2);
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(allocator, &stats);
+    CHECK(stats.count == 1);
+    CHECK(frag::coroutine_stats<handler_a_t>().get().count == 1);
+
+    task.resume();
+    CHECK(task.done());
+    CHECK(task.get() == 3);
+  }
+
+  SECTION("it finds the allocator after other arguments") {
+    frag::task<int, handler_a_t> task = add_later(1, 2, allocator);
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(allocator, &stats);
+    CHECK(stats.count == 1);
+    task.resume();
+    CHECK(task.get() == 3);
+  }
+
+  SECTION("it frees the frame with the task") {
+    {
+      frag::task<int, handler_a_t> task = add(allocator, 1, 2);
+    }
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(allocator, &stats);
+    CHECK(stats.count == 0);
+    CHECK(frag::coroutine_stats<handler_a_t>().get().count == 0);
+    CHECK(frag::coroutine_stats<handler_a_t>().get().count_peak >= 1);
+  }
+
+  SECTION("it recycles pooled frames") {
+    frag::task<int, handler_b_t> task = sum_pooled(100);
+    task.resume();
+    CHECK(task.done());
+    CHECK(task.get() == 100 * 99 / 2 + 100);
+    CHECK(frag::coroutine_stats<handler_b_t>().get().count == 1);
+    CHECK(frag::coroutine_stats<handler_b_t>().get().count_peak == 2);
+  }
+
+  SECTION("it rethrows exceptions") {
+    frag::task<void, handler_b_t> task = fail();
+    task.resume();
+    CHECK(task.done());
+    CHECK_THROWS_AS(task.get(), int);
+  }
+}
+#endif
@@ -0,0 +1,150 @@
+#include <atomic>
+#include <thread>
+#include "utils.h"
+
+static size_t alloc_count(frag_allocator_t* allocator) {
+  frag_allocator_stats_t stats;
+  frag_allocator_stats(allocator, &stats);
+  return stats.count;
+}
+
+TEST_CASE("frag_free_deferred", "[epoch]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+  frag_allocator_t* group = frag_group_allocator_create(system, "group", true, system);
+  DEFER([&] {
+    frag_allocator_destroy(system, group);
+  });
+
+  SECTION("it frees the memory once there are no readers") {
+    void* ptr = frag_alloc(group, 16);
+    frag_free_deferred(group, ptr);
+    frag_epoch_synchronize();
+    CHECK(alloc_count(group) == 0);
+  }
+
+  SECTION("it doesn't free the memory while a reader is inside an epoch") {
+    std::atomic<int> stage(0);
+    std::thread reader([&] {
+      frag_epoch_enter();
+      stage = 1;
+      while (stage != 2) {
+        std::this_thread::yield();
+      }
+      frag_epoch_exit();
+    });
+    while (stage != 1) {
+      std::this_thread::yield();
+    }
+
+    for (int index = 0; index < 1000; ++index) {
+      frag_free_deferred(group, frag_alloc(group, 16));
+    }
+    for (int index = 0; index < 10; ++index) {
+      frag_epoch_collect();
+    }
+    CHECK(alloc_count(group) == 1000);
+
+    stage = 2;
+    reader.join();
+    frag_epoch_synchronize();
+    CHECK(alloc_count(group) == 0);
+  }
+
+  SECTION("it supports nested read-side sections") {
+    frag_epoch_enter();
+    frag_epoch_enter();
+    frag_epoch_exit();
+    frag_epoch_exit();
+    CHECK_THROWS(frag_epoch_exit());
+  }
+
+  SECTION("it can free memory from a background thread") {
+    frag_epoch_reclaimer_start(1);
+    for (int index = 0; index < 1000; ++index) {
+      frag_free_deferred(group, frag_alloc(group, 16));
+    }
+    for (int attempt = 0; attempt < 1000 && alloc_count(group) > 1000 % 64; ++attempt) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(alloc_count(group) == 1000 % 64);
+    frag_epoch_reclaimer_stop();
+    frag_epoch_synchronize();
+    CHECK(alloc_count(group) == 0);
+  }
+}
+
+TEST_CASE("frag_epoch_synchronize", "[epoch]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+  frag_allocator_t* group = frag_group_allocator_create(system, "group", true, system);
+  DEFER([&] {
+    frag_allocator_destroy(system, group);
+  });
+
+  SECTION("it returns while other threads keep retiring memory") {
+    std::atomic<bool> stop(false);
+    std::thread writer([&] {
+      while (!stop) {
+        frag_free_deferred(group, frag_alloc(group, 16));
+      }
+      frag_epoch_synchronize();
+    });
+    for (int index = 0; index < 10; ++index) {
+      frag_epoch_synchronize();
+    }
+    stop = true;
+    writer.join();
+    frag_epoch_synchronize();
+    CHECK(alloc_count(group) == 0);
+  }
+}
+
+static void ignore_out_of_memory(const frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func) {
+}
+
+TEST_CASE("frag_free_deferred without room for a batch", "[epoch]") {
+  frag_config_t config;
+  frag_config_init(&config);
+  config.report_out_of_memory = &ignore_out_of_memory;
+  init_t init(&config);
+  frag_allocator_t* system = frag_system_allocator();
+  frag_allocator_t* metadata = frag_metadata_allocator();
+
+  // make sure the thread is registered before the metadata allocator is cut off
+  frag_epoch_enter();
+  frag_epoch_exit();
+  frag_allocator_stats_t stats;
+  frag_allocator_stats(metadata, &stats);
+  frag_allocator_set_budget(metadata, 0, stats.bytes);
+  DEFER([&] {
+    frag_allocator_set_budget(metadata, 0, 0);
+  });
+
+  SECTION("it frees the memory straight away") {
+    void* ptr = frag_alloc(system, 16);
+    frag_allocator_stats(system, &stats);
+    const size_t count = stats.count;
+    frag_free_deferred(system, ptr);
+    CHECK(alloc_count(system) == count - 1);
+  }
+
+  SECTION("it frees the memory straight away from inside a read-side section") {
+    void* ptr = frag_alloc(system, 16);
+    frag_allocator_stats(system, &stats);
+    const size_t count = stats.count;
+    frag_epoch_enter();
+    frag_free_deferred(system, ptr);
+    frag_epoch_exit();
+    CHECK(alloc_count(system) == count - 1);
+  }
+}
+
+TEST_CASE("frag_free_deferred on shutdown", "[epoch]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  SECTION("it frees any outstanding memory when the library shuts down") {
+    frag_free_deferred(system, frag_alloc(system, 16));
+  }
+}
@@ -0,0 +1,102 @@
+#include "utils.h"
+
+TEST_CASE("fragmentation", "[fragmentation]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+  frag_allocator_layout_t layout;
+
+  SECTION("it reports the free blocks of a buddy allocator") {
+    const size_t range_size = 64 * 1024;
+    void* range = frag_alloc_aligned(system, range_size, 4096);
+    frag_allocator_t* allocator = frag_buddy_allocator_create(system, "buddy", true, range, range_size, 64);
+    DEFER([&] {
+      frag_allocator_destroy(system, allocator);
+      frag_free(system, range);
+    });
+
+    REQUIRE(frag_allocator_fragmentation(allocator, &layout));
+    CHECK(layout.committed_bytes == range_size);
+    CHECK(layout.free_bytes == range_size);
+    CHECK(layout.largest_free_block == range_size);
+    CHECK(layout.free_block_count == 1);
+    CHECK(layout.fragmentation == 0.0);
+
+    void* ptrs[4];
+    for (int index = 0; index < 4; ++index) {
+      ptrs[index] = frag_alloc(allocator, 16 * 1024);
+    }
+    frag_free(allocator, ptrs[0]);
+    frag_free(allocator, ptrs[2]);
+
+    REQUIRE(frag_allocator_fragmentation(allocator, &layout));
+    CHECK(layout.free_bytes == 32 * 1024);
+    CHECK(layout.largest_free_block == 16 * 1024);
+    CHECK(layout.free_block_count == 2);
+    CHECK(layout.fragmentation == 0.5);
+    REQUIRE(layout.size_class_count == 11);
+    CHECK(layout.size_classes[0].block_size == 64);
+    CHECK(layout.size_classes[8].block_size == 16 * 1024);
+    CHECK(layout.size_classes[8].used_count == 2);
+    CHECK(layout.size_classes[8].free_count == 2);
+
+    frag_free(allocator, ptrs[1]);
+    frag_free(allocator, ptrs[3]);
+  }
+
+  SECTION("it reports the space left on a stack") {
+    char buf[1024];
+    frag_allocator_t* allocator = frag_fixed_stack_allocator_create(system, "stack", true, buf, sizeof(buf));
+    DEFER([&] {
+      frag_allocator_destroy(system, allocator);
+    });
+    void* ptr = frag_alloc(allocator, 100);
+
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(allocator, &stats);
+    REQUIRE(frag_allocator_fragmentation(allocator, &layout));
+    CHECK(layout.committed_bytes == sizeof(buf));
+    CHECK(layout.free_bytes == sizeof(buf) - stats.bytes);
+    CHECK(layout.largest_free_block == layout.free_bytes);
+    CHECK(layout.free_block_count == 1);
+    CHECK(layout.size_class_count == 0);
+    frag_free(allocator, ptr);
+  }
+
+  SECTION("it only counts the committed part of a vm stack") {
+    frag_allocator_t* allocator = frag_vm_stack_allocator_create(system, "vm_stack", true, 1024 * 1024 * 1024, SIZE_MAX);
+    DEFER([&] {
+      frag_allocator_destroy(system, allocator);
+    });
+    void* ptr = frag_alloc(allocator, 100);
+
+    REQUIRE(frag_allocator_fragmentation(allocator, &layout));
+    CHECK(layout.committed_bytes > 100);
+    CHECK(layout.committed_bytes < 1024 * 1024);
+    CHECK(layout.free_bytes < layout.committed_bytes);
+    frag_free(allocator, ptr);
+  }
+
+  SECTION("it reports the size classes of the metadata allocator") {
+    void* ptr = frag_alloc(frag_metadata_allocator(), 100);
+    REQUIRE(frag_allocator_fragmentation(frag_metadata_allocator(), &layout));
+    CHECK(layout.committed_bytes > 0);
+    REQUIRE(layout.size_class_count >= 2);
+    CHECK(layout.size_classes[1].block_size == 128);
+    CHECK(layout.size_classes[1].used_count >= 1);
+    frag_free(frag_metadata_allocator(), ptr);
+  }
+
+  SECTION("it only counts the committed part of big free metadata blocks") {
+    void* big = frag_alloc(frag_metadata_allocator(), 1024 * 1024);
+    frag_free(frag_metadata_allocator(), big);
+    REQUIRE(frag_allocator_fragmentation(frag_metadata_allocator(), &layout));
+    CHECK(layout.free_bytes <= layout.committed_bytes);
+    CHECK(layout.largest_free_block < 1024 * 1024);
+  }
+
+  SECTION("it returns false for allocators that can't describe their layout") {
+    layout.free_bytes = 1;
+    CHECK_FALSE(frag_allocator_fragmentation(system, &layout));
+    CHECK(layout.free_bytes == 0);
+  }
+}
@@ -0,0 +1,135 @@
+#include "utils.h"
+
+TEST_CASE("frame allocator", "[frame]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  const size_t buf_size = 2048;
+  char buf[buf_size];
+  frag_allocator_t* allocator = frag_frame_allocator_create(system, "frame", true, buf, buf_size, 2);
+  DEFER([&] {
+    frag_allocator_destroy(system, allocator);
+  });
+
+  SECTION("it can allocate properly aligned memory") {
+    void* ptr = frag_alloc_aligned(allocator, 16, 64);
+    REQUIRE(is_aligned_ptr(ptr, 64));
+    frag_free(allocator, ptr);
+  }
+
+  SECTION("it allows frees in any order") {
+    void* ptr1 = frag_alloc(allocator, 16);
+    void* ptr2 = frag_alloc(allocator, 32);
+    frag_free(allocator, ptr1);
+    frag_free(allocator, ptr2);
+  }
+
+  SECTION("it allocates from a different buffer after advancing") {
+    void* ptr1 = frag_alloc(allocator, 16);
+    frag_frame_allocator_advance(allocator);
+    void* ptr2 = frag_alloc(allocator, 16);
+    CHECK((uintptr_t)ptr2 >= (uintptr_t)buf + buf_size / 2);
+    frag_free(allocator, ptr1);
+    frag_free(allocator, ptr2);
+  }
+
+  SECTION("it reuses the oldest buffer once all frames have been advanced") {
+    void* ptr1 = frag_alloc(allocator, 16);
+    frag_free(allocator, ptr1);
+    frag_frame_allocator_advance(allocator);
+    frag_frame_allocator_advance(allocator);
+    void* ptr2 = frag_alloc(allocator, 16);
+    CHECK(ptr2 == ptr1);
+    frag_free(allocator, ptr2);
+  }
+
+  SECTION("it tracks the usage of each frame") {
+    frag_allocator_stats_t stats;
+    void* ptr1 = frag_alloc(allocator, 16);
+    void* ptr2 = frag_alloc(allocator, 16);
+    frag_frame_allocator_advance(allocator);
+    void* ptr3 = frag_alloc(allocator, 16);
+
+    frag_frame_allocator_stats(allocator, 0, &stats);
+    CHECK(stats.count == 1);
+    frag_frame_allocator_stats(allocator, 1, &stats);
+    CHECK(stats.count == 2);
+    CHECK(stats.count_peak == 2);
+    frag_allocator_stats(allocator, &stats);
+    CHECK(stats.count == 3);
+
+    frag_free(allocator, ptr1);
+    frag_free(allocator, ptr2);
+    frag_free(allocator, ptr3);
+    frag_frame_allocator_stats(allocator, 1, &stats);
+    CHECK(stats.count == 0);
+    CHECK(stats.bytes == 0);
+  }
+
+  SECTION("it fails when the frame is full") {
+    CHECK_THROWS(frag_alloc(allocator, buf_size));
+  }
+}
+
+TEST_CASE("frame allocator detects memory leaks", "[frame]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  const size_t buf_size = 2048;
+  char buf[buf_size];
+  frag_allocator_t* allocator = frag_frame_allocator_create(system, "frame", true, buf, buf_size, 2);
+  DEFER([&] {
+    frag_allocator_destroy(system, allocator);
+  });
+
+  SECTION("it detects allocations that outlive their frame") {
+    void* ptr = frag_alloc(allocator, 16);
+    frag_frame_allocator_advance(allocator);
+    CHECK_THROWS(frag_frame_allocator_advance(allocator));
+    frag_free(allocator, ptr);
+    frag_frame_allocator_advance(allocator);
+  }
+
+  SECTION("it detects memory leaks on shutdown") {
+    void* ptr = frag_alloc(allocator, 16);
+    CHECK_THROWS(frag_allocator_destroy(system, allocator));
+    frag_free(allocator, ptr);
+  }
+}
+
+static unsigned int s_leaked_count;
+
+static void count_leaks(const frag_allocator_t* allocator, const frag_leak_report_t* report) {
+  s_leaked_count += report->alloc_count;
+}
+
+TEST_CASE("frame allocator releases leaked allocations", "[frame]") {
+  frag_config_t config;
+  frag_config_init(&config);
+  config.report_leak = &count_leaks;
+  config.enable_detailed_leak_reports = true;
+  init_t init(&config);
+  frag_allocator_t* system = frag_system_allocator();
+
+  const size_t buf_size = 2048;
+  char buf[buf_size];
+  frag_allocator_t* allocator = frag_frame_allocator_create(system, "frame", true, buf, buf_size, 2);
+  DEFER([&] {
+    frag_allocator_destroy(system, allocator);
+  });
+
+  SECTION("it reports only the allocations from the recycled frame") {
+    s_leaked_count = 0;
+    frag_alloc(allocator, 16);
+    frag_alloc(allocator, 16);
+    frag_frame_allocator_advance(allocator);
+    void* ptr = frag_alloc(allocator, 16);
+    frag_frame_allocator_advance(allocator);
+    CHECK(s_leaked_count == 2);
+
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(allocator, &stats);
+    CHECK(stats.count == 1);
+    frag_free(allocator, ptr);
+  }
+}
@@ -78,3 +78,214 @@ TEST_CASE("frag_realloc", "[general]") {
     frag_free(system, ptr);
   }
 }
+
+struct trimmable_t {
+  size_t idle_bytes;
+  unsigned int trim_calls;
+};
+
+static void* trimmable_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  return NULL;
+}
+
+static void trimmable_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
+}
+
+static size_t trimmable_get_size(const frag_allocator_t* allocator, void* ptr) {
+  return 0;
+}
+
+static void trimmable_shutdown(frag_allocator_t* allocator) {
+}
+
+static trimmable_t s_trimmable;
+
+static size_t trimmable_trim(frag_allocator_t* allocator, size_t keep_bytes, size_t max_release_bytes) {
+  ++s_trimmable.trim_calls;
+  if (s_trimmable.idle_bytes <= keep_bytes) {
+    return 0;
+  }
+  size_t released = s_trimmable.idle_bytes - keep_bytes;
+  if (released > max_release_bytes) {
+    released = max_release_bytes;
+  }
+  s_trimmable.idle_bytes -= released;
+  return released;
+}
+
+TEST_CASE("frag_allocator_trim", "[general]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  frag_allocator_desc_t desc = {};
+  desc.name = "trimmable";
+  desc.needs_lock = true;
+  desc.alloc = &trimmable_alloc;
+  desc.free = &trimmable_free;
+  desc.get_size = &trimmable_get_size;
+  desc.shutdown = &trimmable_shutdown;
+  desc.trim = &trimmable_trim;
+  frag_allocator_t* allocator = frag_allocator_create(system, &desc);
+  DEFER([&] {
+    frag_allocator_destroy(system, allocator);
+  });
+  s_trimmable = trimmable_t();
+  s_trimmable.idle_bytes = 4 * 1024 * 1024;
+
+  SECTION("it releases everything above the amount to keep") {
+    CHECK(frag_allocator_trim(allocator, 1024) == 4 * 1024 * 1024 - 1024);
+    CHECK(s_trimmable.idle_bytes == 1024);
+    CHECK(frag_allocator_trim(allocator, 1024) == 0);
+  }
+
+  SECTION("it releases memory in steps when trimming incrementally") {
+    CHECK(frag_allocator_trim_incremental(allocator, 0, 1000000) == 4 * 1024 * 1024);
+    CHECK(s_trimmable.idle_bytes == 0);
+    CHECK(s_trimmable.trim_calls > 1);
+  }
+
+  SECTION("it forwards trims through group allocators") {
+    frag_allocator_t* group = frag_group_allocator_create(system, "group", true, allocator);
+    CHECK(frag_allocator_trim(group, 0) == 4 * 1024 * 1024);
+    frag_allocator_destroy(system, group);
+  }
+
+  SECTION("it releases nothing for allocators that can't trim") {
+    char buf[64];
+    frag_allocator_t* stack = frag_fixed_stack_allocator_create(system, "stack", true, buf, sizeof(buf));
+    CHECK(frag_allocator_trim(stack, 0) == 0);
+    frag_allocator_destroy(system, stack);
+  }
+
+  SECTION("it can trim the system allocator") {
+    frag_allocator_trim(system, 0);
+  }
+}
+
+struct pressure_log_t {
+  int calls = 0;
+  size_t bytes = 0;
+  void* evict = nullptr;
+  frag_allocator_t* allocator = nullptr;
+};
+
+static void on_pressure(frag_allocator_t* allocator, size_t bytes, size_t soft_limit, void* user_data) {
+  pressure_log_t* log = (pressure_log_t*)user_data;
+  ++log->calls;
+  log->bytes = bytes;
+  log->allocator = allocator;
+
+  // the allocator isn't locked so the handler can free memory back to it
+  if (log->evict != nullptr) {
+    frag_free(allocator, log->evict);
+    log->evict = nullptr;
+  }
+}
+
+TEST_CASE("frag_allocator_set_budget", "[general]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+  frag_allocator_t* group = frag_group_allocator_create(system, "group", true, system);
+  DEFER([&] {
+    frag_allocator_destroy(system, group);
+  });
+
+  SECTION("it fails allocations past the hard limit") {
+    frag_allocator_set_budget(group, 0, 1024);
+    void* ptr = frag_alloc(group, 512);
+    CHECK_THROWS(frag_alloc(group, 1024));
+    frag_free(group, ptr);
+    ptr = frag_alloc(group, 512);
+    CHECK(ptr != nullptr);
+    frag_free(group, ptr);
+  }
+
+  SECTION("it calls the pressure handler when crossing the soft limit") {
+    pressure_log_t log;
+    frag_allocator_set_budget(group, 1024, 0);
+    frag_allocator_set_pressure_handler(group, &on_pressure, &log);
+    void* ptr1 = frag_alloc(group, 512);
+    CHECK(log.calls == 0);
+    void* ptr2 = frag_alloc(group, 600);
+    CHECK(log.calls == 1);
+    CHECK(log.bytes >= 1024);
+
+    // it only fires again once usage has dropped back below the limit
+    void* ptr3 = frag_alloc(group, 16);
+    CHECK(log.calls == 1);
+    frag_free(group, ptr2);
+    frag_free(group, ptr3);
+    log.evict = ptr1;
+    void* ptr4 = frag_alloc(group, 600);
+    CHECK(log.calls == 2);
+    CHECK(log.evict == nullptr);
+    frag_free(group, ptr4);
+  }
+
+  SECTION("it calls the pressure handler when growing in place") {
+    pressure_log_t log;
+    char buf[4096];
+    frag_allocator_t* stack = frag_fixed_stack_allocator_create(system, "stack", true, buf, sizeof(buf));
+    frag_allocator_set_budget(stack, 1024, 0);
+    frag_allocator_set_pressure_handler(stack, &on_pressure, &log);
+    void* ptr = frag_alloc(stack, 512);
+    REQUIRE(frag_resize(stack, ptr, 2048));
+    CHECK(log.calls == 1);
+    CHECK(log.bytes >= 1024);
+
+    // shrinking back under the limit rearms it
+    REQUIRE(frag_resize(stack, ptr, 256));
+    REQUIRE(frag_resize(stack, ptr, 2048));
+    CHECK(log.calls == 2);
+    frag_free(stack, ptr);
+    frag_allocator_destroy(system, stack);
+  }
+
+  SECTION("it covers the allocators created from it together") {
+    frag_allocator_t* child1 = frag_group_allocator_create(group, "child1", true, system);
+    frag_allocator_t* child2 = frag_group_allocator_create(group, "child2", true, system);
+
+    // the limit applies even though it was set after they were created
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(group, &stats);
+    frag_allocator_set_budget(group, 0, stats.bytes + 1536);
+    void* ptr1 = frag_alloc(child1, 1024);
+    CHECK_THROWS(frag_alloc(child2, 1024));
+    void* ptr2 = frag_alloc(child2, 256);
+    CHECK(ptr2 != nullptr);
+
+    frag_free(child2, ptr2);
+    frag_free(child1, ptr1);
+    frag_allocator_destroy(group, child2);
+    frag_allocator_destroy(group, child1);
+  }
+
+  SECTION("it calls the pressure handler of the allocator the budget is on") {
+    pressure_log_t log;
+    frag_allocator_set_budget(group, 4096, 0);
+    frag_allocator_set_pressure_handler(group, &on_pressure, &log);
+    frag_allocator_t* child = frag_group_allocator_create(group, "child", true, system);
+
+    // the child gets a budget of its own but not the owner's handler
+    frag_allocator_set_budget(child, 16, 0);
+    void* ptr1 = frag_alloc(child, 512);
+    CHECK(log.calls == 0);
+    void* ptr2 = frag_alloc(child, 4096);
+    CHECK(log.calls == 1);
+    CHECK(log.allocator == group);
+    CHECK(log.bytes >= 4096);
+
+    frag_free(child, ptr2);
+    frag_free(child, ptr1);
+    frag_allocator_destroy(group, child);
+  }
+
+  SECTION("it covers allocations passed through from other allocators") {
+    frag_allocator_set_budget(group, 0, 1024);
+    frag_allocator_t* outer = frag_group_allocator_create(system, "outer", true, group);
+    void* ptr = frag_alloc(outer, 512);
+    CHECK_THROWS(frag_alloc(outer, 1024));
+    frag_free(outer, ptr);
+    frag_allocator_destroy(system, outer);
+  }
+}
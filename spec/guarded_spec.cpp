@@ -0,0 +1,172 @@
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "utils.h"
+
+TEST_CASE("guarded allocator", "[guarded]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+  const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+  frag_allocator_t* delegate = frag_group_allocator_create(system, "delegate", true, system);
+  DEFER([&] {
+    frag_allocator_destroy(system, delegate);
+  });
+
+  SECTION("it puts sampled allocations against the end of a page") {
+    frag_allocator_t* allocator = frag_guarded_allocator_create(system, "guarded", true, delegate, 4, 1);
+    char* ptr = (char*)frag_alloc(allocator, 128);
+    CHECK(is_aligned_ptr(ptr + 128, page_size));
+    char* aligned = (char*)frag_alloc_aligned(allocator, 100, 64);
+    CHECK(is_aligned_ptr(aligned, 64));
+    CHECK((uintptr_t)(aligned + 100) <= ((uintptr_t)aligned / page_size + 1) * page_size);
+
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(delegate, &stats);
+    CHECK(stats.count == 0);
+
+    frag_free(allocator, aligned);
+    frag_free(allocator, ptr);
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it passes everything through when sampling is disabled") {
+    frag_allocator_t* allocator = frag_guarded_allocator_create(system, "guarded", true, delegate, 4, 0);
+    void* ptr = frag_alloc(allocator, 128);
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(delegate, &stats);
+    CHECK(stats.count == 1);
+    frag_free(allocator, ptr);
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it passes allocations through once the slots run out or they don't fit") {
+    frag_allocator_t* allocator = frag_guarded_allocator_create(system, "guarded", true, delegate, 2, 1);
+    void* ptr1 = frag_alloc(allocator, 16);
+    void* ptr2 = frag_alloc(allocator, 16);
+    void* ptr3 = frag_alloc(allocator, 16);
+    void* big = frag_alloc(allocator, page_size + 1);
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(delegate, &stats);
+    CHECK(stats.count == 2);
+    frag_free(allocator, ptr1);
+    frag_free(allocator, ptr2);
+    frag_free(allocator, ptr3);
+    frag_free(allocator, big);
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it describes the layout of its slots") {
+    frag_allocator_t* allocator = frag_guarded_allocator_create(system, "guarded", true, delegate, 4, 1);
+    void* ptr1 = frag_alloc(allocator, 16);
+    void* ptr2 = frag_alloc(allocator, 16);
+    frag_free(allocator, ptr1);
+
+    frag_allocator_layout_t layout;
+    REQUIRE(frag_allocator_fragmentation(allocator, &layout));
+    CHECK(layout.committed_bytes == page_size);
+    CHECK(layout.free_bytes == 0);
+    CHECK(layout.size_class_count == 1);
+    CHECK(layout.size_classes[0].block_size == page_size);
+    CHECK(layout.size_classes[0].used_count == 1);
+    CHECK(layout.size_classes[0].free_count == 3);
+
+    frag_free(allocator, ptr2);
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it samples about one in every sample_rate allocations") {
+    frag_allocator_t* allocator = frag_guarded_allocator_create(system, "guarded", true, delegate, 1000, 8);
+    void* ptrs[800];
+    for (void*& ptr : ptrs) {
+      ptr = frag_alloc(allocator, 16);
+    }
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(delegate, &stats);
+    CHECK(stats.count > 600);
+    CHECK(stats.count < 760);
+    for (void* ptr : ptrs) {
+      frag_free(allocator, ptr);
+    }
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it hands out zeroed memory") {
+    frag_allocator_t* allocator = frag_guarded_allocator_create(system, "guarded", true, delegate, 1, 1);
+    for (int iter = 0; iter < 2; ++iter) {
+      unsigned char* ptr = (unsigned char*)frag_alloc_zero(allocator, 256);
+      bool is_zero = true;
+      for (size_t index = 0; index < 256; ++index) {
+        is_zero = is_zero && ptr[index] == 0;
+      }
+      CHECK(is_zero);
+      memset(ptr, 0xff, 256);
+      frag_free(allocator, ptr);
+    }
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it detects double frees") {
+    frag_allocator_t* allocator = frag_guarded_allocator_create(system, "guarded", true, delegate, 4, 1);
+    void* ptr = frag_alloc(allocator, 16);
+    frag_free(allocator, ptr);
+    CHECK_THROWS(frag_free(allocator, ptr));
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it detects memory leaks on shutdown") {
+    frag_allocator_t* allocator = frag_guarded_allocator_create(system, "guarded", true, delegate, 4, 1);
+    void* ptr = frag_alloc(allocator, 16);
+    CHECK_THROWS(frag_allocator_destroy(system, allocator));
+    frag_free(allocator, ptr);
+    frag_allocator_destroy(system, allocator);
+  }
+}
+
+static const char* s_expected_alloc_func;
+
+static void exit_with_fault(const frag_allocator_t* allocator, const frag_guard_fault_t* fault) {
+  const bool has_site = fault->alloc_func != nullptr && strcmp(fault->alloc_func, s_expected_alloc_func) == 0;
+  _exit(has_site ? 10 + (int)fault->kind : 1);
+}
+
+static int run_faulting_child(void (*func)(frag_allocator_t* allocator)) {
+  const pid_t pid = fork();
+  if (pid == 0) {
+    frag_config_t config;
+    frag_config_init(&config);
+    config.report_guard_fault = &exit_with_fault;
+    init_t init(&config);
+    frag_allocator_t* system = frag_system_allocator();
+    frag_allocator_t* allocator = frag_guarded_allocator_create(system, "guarded", true, system, 4, 1);
+    func(allocator);
+    _exit(0);
+  }
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void overflow(frag_allocator_t* allocator) {
+  s_expected_alloc_func = __func__;
+  volatile char* ptr = (volatile char*)frag_alloc(allocator, 128);
+  ptr[128] = 1;
+}
+
+static void use_after_free(frag_allocator_t* allocator) {
+  s_expected_alloc_func = __func__;
+  volatile char* ptr = (volatile char*)frag_alloc(allocator, 128);
+  frag_free(allocator, (void*)ptr);
+  ptr[0] = 1;
+}
+
+TEST_CASE("guarded allocator reports faults", "[guarded]") {
+  SECTION("it reports overflows with the allocation site") {
+    CHECK(run_faulting_child(&overflow) == 10 + FRAG_GUARD_FAULT_OVERFLOW);
+  }
+
+  SECTION("it reports use after free with the allocation site") {
+    CHECK(run_faulting_child(&use_after_free) == 10 + FRAG_GUARD_FAULT_USE_AFTER_FREE);
+  }
+}
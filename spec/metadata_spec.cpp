@@ -0,0 +1,52 @@
+#include <string.h>
+#include "utils.h"
+
+static size_t alloc_count(const frag_allocator_t* allocator) {
+  frag_allocator_stats_t stats;
+  frag_allocator_stats(allocator, &stats);
+  return stats.count;
+}
+
+TEST_CASE("metadata allocator", "[metadata]") {
+  frag_config_t config;
+  frag_config_init(&config);
+  config.enable_detailed_leak_reports = true;
+  init_t init(&config);
+  frag_allocator_t* system = frag_system_allocator();
+  frag_allocator_t* metadata = frag_metadata_allocator();
+  REQUIRE(metadata != NULL);
+
+  SECTION("it holds the tracking tables instead of the system allocator") {
+    const size_t metadata_count = alloc_count(metadata);
+    const size_t system_count = alloc_count(system);
+    void* ptr = frag_alloc(system, 16);
+    CHECK(alloc_count(system) == system_count + 1);
+    CHECK(alloc_count(metadata) == metadata_count + 1);
+    frag_free(system, ptr);
+  }
+
+  SECTION("it releases the tracking tables with their allocators") {
+    frag_allocator_t* group = frag_group_allocator_create(system, "group", true, system);
+    const size_t metadata_count = alloc_count(metadata);
+    void* ptr = frag_alloc(group, 16);
+    frag_free(group, ptr);
+    CHECK(alloc_count(metadata) == metadata_count + 1);
+    frag_allocator_destroy(system, group);
+    CHECK(alloc_count(metadata) == metadata_count);
+  }
+
+  SECTION("it can be allocated from directly") {
+    void* ptr = frag_alloc_aligned(metadata, 100, 256);
+    CHECK(is_aligned_ptr(ptr, 256));
+    CHECK(frag_usable_size(metadata, ptr) >= 100);
+    CHECK(frag_resize(metadata, ptr, 120));
+    frag_free(metadata, ptr);
+
+    void* big = frag_alloc(metadata, 1024 * 1024);
+    memset(big, 1, 1024 * 1024);
+    frag_free(metadata, big);
+    big = frag_alloc(metadata, 1024 * 1024);
+    memset(big, 1, 1024 * 1024);
+    frag_free(metadata, big);
+  }
+}
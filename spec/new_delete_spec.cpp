@@ -1,3 +1,4 @@
+#include <stdexcept>
 #include "utils.h"
 
 struct my_type_t {
@@ -12,6 +13,47 @@ struct my_type_t {
   int32_t value;
 };
 
+struct counted_t {
+  counted_t() {
+    value = 100;
+    ++s_live;
+  }
+
+  ~counted_t() {
+    --s_live;
+  }
+
+  int32_t value;
+
+  static int s_live;
+};
+
+int counted_t::s_live = 0;
+
+// throws from the constructor once `s_constructions_left` reaches zero
+struct construct_failure_t {
+  construct_failure_t() {
+    if (s_constructions_left-- == 0) {
+      throw std::runtime_error("constructor failed");
+    }
+    ++s_live;
+  }
+
+  ~construct_failure_t() {
+    --s_live;
+  }
+
+  static int s_constructions_left;
+  static int s_live;
+};
+
+int construct_failure_t::s_constructions_left = 0;
+int construct_failure_t::s_live = 0;
+
+struct alignas(64) over_aligned_t {
+  char value;
+};
+
 TEST_CASE("new_delete", "[cpp]") {
   init_t init(nullptr);
   frag_allocator_t* system = frag_system_allocator();
@@ -30,3 +72,65 @@ TEST_CASE("new_delete", "[cpp]") {
     frag_delete(system, ptr);
   }
 }
+
+TEST_CASE("new_delete arrays", "[cpp]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  SECTION("it constructs and destroys every element") {
+    counted_t* array = frag_new_array(system, counted_t, 10);
+    REQUIRE(array != NULL);
+    CHECK(counted_t::s_live == 10);
+    CHECK(array[0].value == 100);
+    CHECK(array[9].value == 100);
+    frag_delete_array(system, array);
+    CHECK(counted_t::s_live == 0);
+  }
+
+  SECTION("it doesn't store a count for trivial types") {
+    // the array is the start of the allocation so the allocator can tell how big it is
+    int32_t* array = frag_new_array(system, int32_t, 16);
+    CHECK(frag_usable_size(system, array) >= 16 * sizeof(int32_t));
+    frag_delete_array(system, array);
+  }
+
+  SECTION("it aligns over aligned types") {
+    over_aligned_t* array = frag_new_array(system, over_aligned_t, 3);
+    CHECK(is_aligned_ptr(array, 64));
+    frag_delete_array(system, array);
+  }
+
+  SECTION("it frees by size") {
+    const size_t range_size = 64 * 1024;
+    char* range = (char*)frag_alloc_aligned(system, range_size, 4096);
+    frag_allocator_t* allocator = frag_buddy_allocator_create(system, "buddy", true, range, range_size, 64);
+    DEFER([&] {
+      frag_allocator_destroy(system, allocator);
+      frag_free(system, range);
+    });
+
+    counted_t* array = frag_new_array(allocator, counted_t, 100);
+    frag_delete_array(allocator, array);
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(allocator, &stats);
+    CHECK(stats.count == 0);
+    CHECK(counted_t::s_live == 0);
+  }
+
+  SECTION("it cleans up after a constructor that throws") {
+    frag_allocator_stats_t before;
+    frag_allocator_stats(system, &before);
+    construct_failure_t::s_constructions_left = 5;
+    CHECK_THROWS_AS(frag_new_array(system, construct_failure_t, 10), std::runtime_error);
+    CHECK(construct_failure_t::s_live == 0);
+    frag_allocator_stats_t after;
+    frag_allocator_stats(system, &after);
+    CHECK(after.count == before.count);
+  }
+
+  SECTION("it handles empty arrays") {
+    counted_t* array = frag_new_array(system, counted_t, 0);
+    frag_delete_array(system, array);
+    frag_delete_array(system, (counted_t*)NULL);
+  }
+}
@@ -0,0 +1,259 @@
+#include "frag_object_cache.h"
+#include "utils.h"
+
+struct counts_t {
+  int constructed;
+  int destructed;
+};
+
+static bool count_ctor(void* object, void* user_data) {
+  *(int*)object = 42;
+  ++((counts_t*)user_data)->constructed;
+  return true;
+}
+
+static void count_dtor(void* object, void* user_data) {
+  ++((counts_t*)user_data)->destructed;
+}
+
+struct pressure_trim_t {
+  frag_allocator_t* cache;
+  int calls;
+};
+
+static void trim_on_pressure(frag_allocator_t* allocator, size_t bytes, size_t soft_limit, void* user_data) {
+  pressure_trim_t* trim = (pressure_trim_t*)user_data;
+  ++trim->calls;
+  frag_allocator_trim(trim->cache, 0);
+}
+
+// allocates from the cache while it's unlocked waiting on its delegate for a slab, like another thread could
+struct pressure_alloc_t {
+  frag_allocator_t* cache;
+  void* ptr;
+};
+
+static void alloc_on_pressure(frag_allocator_t* allocator, size_t bytes, size_t soft_limit, void* user_data) {
+  pressure_alloc_t* alloc = (pressure_alloc_t*)user_data;
+  alloc->ptr = frag_alloc(alloc->cache, 24);
+}
+
+struct widget_t {
+  widget_t() {
+    ++s_constructed;
+  }
+
+  ~widget_t() {
+    ++s_destructed;
+  }
+
+  static int s_constructed;
+  static int s_destructed;
+  int uses = 0;
+};
+
+int widget_t::s_constructed = 0;
+int widget_t::s_destructed = 0;
+
+struct alignas(64) throwing_t {
+  throwing_t() {
+    throw 1;
+  }
+};
+
+TEST_CASE("object cache allocator", "[object_cache]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+  frag_allocator_t* delegate = frag_group_allocator_create(system, "delegate", true, system);
+  DEFER([&] {
+    frag_allocator_destroy(system, delegate);
+  });
+
+  counts_t counts = {0, 0};
+  frag_allocator_t* allocator = frag_object_cache_allocator_create(system, "cache", true, delegate, 24, 0, &count_ctor, &count_dtor, &counts);
+
+  SECTION("it hands back freed objects without constructing them again") {
+    int* ptr = (int*)frag_alloc(allocator, 24);
+    CHECK(*ptr == 42);
+    *ptr = 7;
+    frag_free(allocator, ptr);
+    int* ptr2 = (int*)frag_alloc(allocator, 24);
+    CHECK(ptr2 == ptr);
+    CHECK(*ptr2 == 7);
+    CHECK(counts.constructed == 1);
+    CHECK(counts.destructed == 0);
+    frag_free(allocator, ptr2);
+    frag_allocator_destroy(system, allocator);
+    CHECK(counts.destructed == 1);
+  }
+
+  SECTION("it counts objects in use in its stats") {
+    void* ptr1 = frag_alloc(allocator, 24);
+    void* ptr2 = frag_alloc(allocator, 16);
+    CHECK(is_aligned_ptr(ptr1, 16));
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(allocator, &stats);
+    CHECK(stats.count == 2);
+    CHECK(stats.bytes == 64);
+    frag_allocator_stats(delegate, &stats);
+    CHECK(stats.count == 1);
+
+    frag_allocator_layout_t layout;
+    REQUIRE(frag_allocator_fragmentation(allocator, &layout));
+    CHECK(layout.size_class_count == 1);
+    CHECK(layout.size_classes[0].block_size == 32);
+    CHECK(layout.size_classes[0].used_count == 2);
+    CHECK(layout.committed_bytes == 4096);
+
+    frag_free(allocator, ptr1);
+    frag_free(allocator, ptr2);
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it destructs objects when trimming empty slabs") {
+    void* ptrs[500];
+    for (int index = 0; index < 500; ++index) {
+      ptrs[index] = frag_alloc(allocator, 24);
+    }
+    frag_allocator_stats_t before;
+    frag_allocator_stats(delegate, &before);
+    CHECK(before.count > 1);
+    for (int index = 0; index < 500; ++index) {
+      frag_free(allocator, ptrs[index]);
+    }
+    CHECK(counts.destructed == 0);
+
+    CHECK(frag_allocator_trim(allocator, 0) == before.bytes);
+    CHECK(counts.destructed == 500);
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(delegate, &stats);
+    CHECK(stats.count == 0);
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it keeps slabs that are still in use when trimming") {
+    void* ptr = frag_alloc(allocator, 24);
+    CHECK(frag_allocator_trim(allocator, 0) == 0);
+    frag_free(allocator, ptr);
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it can be trimmed from a pressure handler on its delegate") {
+    pressure_trim_t trim = {allocator, 0};
+    frag_allocator_set_budget(delegate, 8192, 0);
+    frag_allocator_set_pressure_handler(delegate, &trim_on_pressure, &trim);
+    void* ptrs[2000];
+    for (int index = 0; index < 2000; ++index) {
+      ptrs[index] = frag_alloc(allocator, 24);
+      REQUIRE(ptrs[index] != nullptr);
+    }
+    CHECK(trim.calls == 1);
+    for (int index = 0; index < 2000; ++index) {
+      frag_free(allocator, ptrs[index]);
+    }
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it gives back a slab it no longer needs after allocating it unlocked") {
+    pressure_alloc_t alloc = {allocator, nullptr};
+    frag_allocator_set_budget(delegate, 1, 0);
+    frag_allocator_set_pressure_handler(delegate, &alloc_on_pressure, &alloc);
+    void* ptr = frag_alloc(allocator, 24);
+    REQUIRE(alloc.ptr != nullptr);
+    CHECK(ptr != alloc.ptr);
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(delegate, &stats);
+    CHECK(stats.count == 1);
+
+    frag_free(allocator, ptr);
+    frag_free(allocator, alloc.ptr);
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it checks its budget again after allocating a slab unlocked") {
+    pressure_alloc_t alloc = {allocator, nullptr};
+    frag_allocator_set_budget(allocator, 0, 32);
+    frag_allocator_set_budget(delegate, 1, 0);
+    frag_allocator_set_pressure_handler(delegate, &alloc_on_pressure, &alloc);
+    CHECK_THROWS(frag_alloc(allocator, 24));
+    CHECK(alloc.ptr != nullptr);
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(allocator, &stats);
+    CHECK(stats.bytes == 32);
+
+    frag_free(allocator, alloc.ptr);
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it rejects freeing an object twice") {
+    void* ptr1 = frag_alloc(allocator, 24);
+    void* ptr2 = frag_alloc(allocator, 24);
+    frag_free(allocator, ptr1);
+    CHECK_THROWS(frag_free(allocator, ptr1));
+    frag_free(allocator, ptr2);
+
+    // the object is only handed out once after that
+    void* ptr3 = frag_alloc(allocator, 24);
+    void* ptr4 = frag_alloc(allocator, 24);
+    CHECK(ptr3 != ptr4);
+    frag_free(allocator, ptr3);
+    frag_free(allocator, ptr4);
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it rejects allocations that don't fit its objects") {
+    CHECK_THROWS(frag_alloc(allocator, 25));
+    CHECK_THROWS(frag_alloc_aligned(allocator, 24, 64));
+    frag_allocator_destroy(system, allocator);
+  }
+}
+
+TEST_CASE("object cache wrapper", "[object_cache]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+  widget_t::s_constructed = 0;
+  widget_t::s_destructed = 0;
+
+  SECTION("it constructs objects once and destroys them on trim") {
+    frag::object_cache<widget_t> cache(system, "widgets", true, system);
+    widget_t* widget = cache.acquire();
+    ++widget->uses;
+    cache.release(widget);
+    widget = cache.acquire();
+    CHECK(widget->uses == 1);
+    CHECK(widget_t::s_constructed == 1);
+    cache.release(widget);
+
+    CHECK(cache.trim() > 0);
+    CHECK(widget_t::s_destructed == 1);
+  }
+
+  SECTION("it destroys its free objects with the cache") {
+    {
+      frag::object_cache<widget_t> cache(system, "widgets", true, system);
+      cache.release(cache.acquire());
+    }
+    CHECK(widget_t::s_destructed == 1);
+  }
+}
+
+static int s_out_of_memory_count = 0;
+
+static void count_out_of_memory(const frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func) {
+  ++s_out_of_memory_count;
+}
+
+TEST_CASE("object cache wrapper with a throwing constructor", "[object_cache]") {
+  frag_config_t config;
+  frag_config_init(&config);
+  config.report_out_of_memory = &count_out_of_memory;
+  init_t init(&config);
+  frag_allocator_t* system = frag_system_allocator();
+  s_out_of_memory_count = 0;
+
+  SECTION("it throws without reporting running out of memory") {
+    frag::object_cache<throwing_t> cache(system, "throwing", true, system);
+    CHECK_THROWS_AS(cache.acquire(), std::bad_alloc);
+    CHECK(s_out_of_memory_count == 0);
+  }
+}
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "utils.h"
+
+namespace {
+struct node_t {
+  node_t* next;
+  int value;
+};
+} // namespace
+
+static void make_path(char* path, size_t size) {
+  snprintf(path, size, "/tmp/frag_spec_persistent_%d", (int)getpid());
+}
+
+static void build_list(frag_allocator_t* allocator, int count) {
+  node_t* head = nullptr;
+  for (int i = count; i > 0; --i) {
+    node_t* node = (node_t*)frag_alloc(allocator, sizeof(node_t));
+    node->next = head;
+    node->value = i;
+    head = node;
+  }
+  frag_persistent_allocator_set_root(allocator, head);
+}
+
+static int sum_list(frag_allocator_t* allocator) {
+  int sum = 0;
+  for (node_t* node = (node_t*)frag_persistent_allocator_root(allocator); node != nullptr; node = node->next) {
+    sum += node->value;
+  }
+  return sum;
+}
+
+static void free_list(frag_allocator_t* allocator) {
+  node_t* node = (node_t*)frag_persistent_allocator_root(allocator);
+  while (node != nullptr) {
+    node_t* next = node->next;
+    frag_free(allocator, node);
+    node = next;
+  }
+  frag_persistent_allocator_set_root(allocator, nullptr);
+}
+
+static void relocate_list(frag_allocator_t* allocator, void* root, ptrdiff_t delta, void* user_data) {
+  ++*(int*)user_data;
+  for (node_t* node = (node_t*)root; node != nullptr; node = node->next) {
+    if (node->next != nullptr) {
+      node->next = (node_t*)((char*)node->next + delta);
+    }
+  }
+}
+
+TEST_CASE("persistent allocator", "[persistent]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  char path[64];
+  make_path(path, sizeof(path));
+  unlink(path);
+  DEFER([&] { unlink(path); });
+
+  const size_t size = 1024 * 1024;
+
+  SECTION("it can allocate properly aligned memory") {
+    frag_allocator_t* allocator = frag_persistent_allocator_create(system, "persistent", true, path, size, nullptr);
+    REQUIRE(allocator != nullptr);
+    void* ptr = frag_alloc_aligned(allocator, 16, 1024);
+    REQUIRE(is_aligned_ptr(ptr, 1024));
+    frag_free(allocator, ptr);
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it maps the data back in with the stats") {
+    frag_allocator_t* allocator = frag_persistent_allocator_create(system, "persistent", true, path, size, nullptr);
+    build_list(allocator, 100);
+    CHECK(frag_persistent_allocator_flush(allocator));
+    frag_allocator_destroy(system, allocator);
+
+    allocator = frag_persistent_allocator_create(system, "persistent", true, path, 0, nullptr);
+    REQUIRE(allocator != nullptr);
+    if (frag_persistent_allocator_relocation_delta(allocator) != 0) {
+      int calls = 0;
+      frag_persistent_allocator_relocate(allocator, &relocate_list, &calls);
+    }
+    CHECK(sum_list(allocator) == 5050);
+
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(allocator, &stats);
+    CHECK(stats.count == 100);
+    CHECK(stats.count_peak == 100);
+
+    free_list(allocator);
+    frag_allocator_stats(allocator, &stats);
+    CHECK(stats.count == 0);
+    CHECK(stats.bytes == 0);
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it relocates pointers when mapped at a different address") {
+    // find two free ranges to map the file at
+    const size_t range_size = 4 * 1024 * 1024;
+    char* ranges = (char*)mmap(nullptr, range_size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    REQUIRE(ranges != MAP_FAILED);
+    munmap(ranges, range_size * 2);
+
+    frag_allocator_t* allocator = frag_persistent_allocator_create(system, "persistent", true, path, size, ranges);
+    build_list(allocator, 10);
+    frag_allocator_destroy(system, allocator);
+
+    allocator = frag_persistent_allocator_create(system, "persistent", true, path, 0, ranges + range_size);
+    REQUIRE(allocator != nullptr);
+    CHECK(frag_persistent_allocator_relocation_delta(allocator) == (ptrdiff_t)range_size);
+    int calls = 0;
+    frag_persistent_allocator_relocate(allocator, &relocate_list, &calls);
+    CHECK(calls == 1);
+    CHECK(frag_persistent_allocator_relocation_delta(allocator) == 0);
+    CHECK(sum_list(allocator) == 55);
+
+    // once relocated it maps back to the new address by default
+    frag_allocator_destroy(system, allocator);
+    allocator = frag_persistent_allocator_create(system, "persistent", true, path, 0, nullptr);
+    CHECK(frag_persistent_allocator_root(allocator) != nullptr);
+    CHECK(frag_persistent_allocator_relocation_delta(allocator) == 0);
+    free_list(allocator);
+    frag_allocator_destroy(system, allocator);
+  }
+
+  SECTION("it reports a leak when nothing is reachable from the root") {
+    frag_allocator_t* allocator = frag_persistent_allocator_create(system, "persistent", true, path, size, nullptr);
+    void* ptr = frag_alloc(allocator, 100);
+    CHECK_THROWS(frag_allocator_destroy(system, allocator));
+    frag_free(allocator, ptr);
+    frag_allocator_destroy(system, allocator);
+  }
+}
+
+static unsigned int s_leaked_count;
+static void* s_leaked_ptr;
+
+static void record_leaks(const frag_allocator_t* allocator, const frag_leak_report_t* report) {
+  s_leaked_count += report->alloc_count;
+  if (report->alloc_count > 0) {
+    s_leaked_ptr = report->allocs[0].ptr;
+  }
+}
+
+TEST_CASE("persistent allocator tracks allocations from earlier runs", "[persistent]") {
+  frag_config_t config;
+  frag_config_init(&config);
+  config.report_leak = &record_leaks;
+  config.enable_detailed_leak_reports = true;
+  init_t init(&config);
+  frag_allocator_t* system = frag_system_allocator();
+
+  char path[64];
+  make_path(path, sizeof(path));
+  unlink(path);
+  DEFER([&] { unlink(path); });
+
+  SECTION("it lists them in leak reports after being reopened") {
+    frag_allocator_t* allocator = frag_persistent_allocator_create(system, "persistent", true, path, 64 * 1024, nullptr);
+    void* ptr = frag_alloc(allocator, 100);
+    frag_persistent_allocator_set_root(allocator, ptr);
+    frag_allocator_destroy(system, allocator);
+
+    s_leaked_count = 0;
+    allocator = frag_persistent_allocator_create(system, "persistent", true, path, 0, nullptr);
+    REQUIRE(frag_persistent_allocator_relocation_delta(allocator) == 0);
+    frag_persistent_allocator_set_root(allocator, nullptr);
+    frag_allocator_destroy(system, allocator);
+    CHECK(s_leaked_count == 1);
+    CHECK(s_leaked_ptr == ptr);
+
+    // freeing it drops it from the tracking again
+    allocator = frag_persistent_allocator_create(system, "persistent", true, path, 0, nullptr);
+    frag_free(allocator, ptr);
+    frag_allocator_destroy(system, allocator);
+    CHECK(s_leaked_count == 1);
+  }
+}
@@ -0,0 +1,42 @@
+// Run by preload_spec.cpp under LD_PRELOAD. It exports frag_preload_configure() with -rdynamic and links its own copy
+// of frag, whose calls into the C library land back in frag_preload.
+#include <stdio.h>
+#include <stdlib.h>
+#include "frag.h"
+#include "frag_preload.h"
+
+static const frag_preload_api_t* s_api;
+static frag_allocator_t* s_allocator;
+static void* s_configure_ptr;
+
+extern "C" frag_allocator_t* frag_preload_configure(frag_allocator_t* system, const frag_preload_api_t* api) {
+  s_api = api;
+  s_allocator = api->group_allocator_create(system, "app", true, system);
+
+  // freed once everything is going through `s_allocator`
+  s_configure_ptr = malloc(64);
+  return s_allocator;
+}
+
+int main() {
+  if (s_allocator == NULL) {
+    printf("not configured\n");
+    return 1;
+  }
+  free(s_configure_ptr);
+
+  frag_lib_init(NULL);
+  void* ptr = frag_alloc(frag_system_allocator(), 64);
+  frag_free(frag_system_allocator(), ptr);
+  frag_lib_shutdown();
+
+  frag_allocator_stats_t before;
+  s_api->allocator_stats(s_allocator, &before);
+  void* ptr2 = malloc(100);
+  frag_allocator_stats_t after;
+  s_api->allocator_stats(s_allocator, &after);
+  free(ptr2);
+
+  printf("routed=%zu\n", after.count - before.count);
+  return 0;
+}
@@ -0,0 +1,27 @@
+#include <stdio.h>
+#include <string>
+#include <sys/wait.h>
+#include "utils.h"
+
+// only built along with frag_preload and preload_app (see CMakeLists.txt)
+static int run_preloaded(std::string* output) {
+  // bounded so a deadlock fails the spec rather than hanging it
+  FILE* pipe = popen("LD_PRELOAD=" FRAG_PRELOAD_LIBRARY " timeout 30 " FRAG_PRELOAD_APP " 2>&1", "r");
+  if (pipe == nullptr) {
+    return -1;
+  }
+  char buf[256];
+  while (fgets(buf, sizeof(buf), pipe) != nullptr) {
+    *output += buf;
+  }
+  const int status = pclose(pipe);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+TEST_CASE("frag_preload", "[preload]") {
+  SECTION("it runs an app that links frag and configures the preload") {
+    std::string output;
+    CHECK(run_preloaded(&output) == 0);
+    CHECK(output == "routed=1\n");
+  }
+}
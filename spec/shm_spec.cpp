@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "utils.h"
+
+static void make_shm_name(char* name, size_t size) {
+  snprintf(name, size, "/frag_spec_%d", (int)getpid());
+}
+
+TEST_CASE("shm allocator", "[shm]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  char shm_name[64];
+  make_shm_name(shm_name, sizeof(shm_name));
+  frag_allocator_t* producer = frag_shm_allocator_create(system, "producer", true, shm_name, 1024 * 1024);
+  REQUIRE(producer != nullptr);
+  frag_allocator_t* consumer = frag_shm_allocator_attach(system, "consumer", true, shm_name);
+  REQUIRE(consumer != nullptr);
+  DEFER([&] {
+    frag_allocator_destroy(system, consumer);
+    frag_allocator_destroy(system, producer);
+  });
+
+  SECTION("it can allocate properly aligned memory") {
+    void* ptr = frag_alloc_aligned(producer, 16, 1024);
+    REQUIRE(is_aligned_ptr(ptr, 1024));
+    frag_free(producer, ptr);
+  }
+
+  SECTION("it hands off memory between attachments using offsets") {
+    char* message = (char*)frag_alloc(producer, 128);
+    strcpy(message, "hello");
+    const size_t offset = frag_shm_allocator_ptr_to_offset(producer, message);
+
+    char* received = (char*)frag_shm_allocator_offset_to_ptr(consumer, offset);
+    CHECK(received != message);
+    CHECK(strcmp(received, "hello") == 0);
+    frag_free(consumer, received);
+
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(producer, &stats);
+    CHECK(stats.count == 0);
+    CHECK(stats.count_peak == 1);
+  }
+
+  SECTION("it shares stats between attachments") {
+    void* ptr = frag_alloc(producer, 100);
+    frag_allocator_stats_t producer_stats;
+    frag_allocator_stats_t consumer_stats;
+    frag_allocator_stats(producer, &producer_stats);
+    frag_allocator_stats(consumer, &consumer_stats);
+    CHECK(producer_stats.count == 1);
+    CHECK(consumer_stats.count == 1);
+    CHECK(consumer_stats.bytes == producer_stats.bytes);
+    frag_free(producer, ptr);
+  }
+
+  SECTION("it hands off memory to another process") {
+    char* message = (char*)frag_alloc(producer, 128);
+    strcpy(message, "hello");
+    const size_t offset = frag_shm_allocator_ptr_to_offset(producer, message);
+
+    const pid_t pid = fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0) {
+      frag_allocator_t* child = frag_shm_allocator_attach(system, "child", true, shm_name);
+      char* received = (char*)frag_shm_allocator_offset_to_ptr(child, offset);
+      const bool ok = strcmp(received, "hello") == 0;
+      frag_free(child, received);
+      frag_allocator_destroy(system, child);
+      _exit(ok ? 0 : 1);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+
+    frag_allocator_stats_t stats;
+    frag_allocator_stats(producer, &stats);
+    CHECK(stats.count == 0);
+  }
+}
+
+TEST_CASE("shm allocator detects memory leaks", "[shm]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  char shm_name[64];
+  make_shm_name(shm_name, sizeof(shm_name));
+  frag_allocator_t* producer = frag_shm_allocator_create(system, "producer", true, shm_name, 64 * 1024);
+  REQUIRE(producer != nullptr);
+  frag_allocator_t* consumer = frag_shm_allocator_attach(system, "consumer", true, shm_name);
+  REQUIRE(consumer != nullptr);
+
+  SECTION("it only reports leaks when the last process detaches") {
+    void* ptr = frag_alloc(producer, 16);
+    const size_t offset = frag_shm_allocator_ptr_to_offset(producer, ptr);
+    frag_allocator_destroy(system, producer);
+    CHECK_THROWS(frag_allocator_destroy(system, consumer));
+    frag_free(consumer, frag_shm_allocator_offset_to_ptr(consumer, offset));
+    frag_allocator_destroy(system, consumer);
+  }
+}
@@ -0,0 +1,103 @@
+#include <string.h>
+#include "utils.h"
+
+static void* alloc_from_site_a(frag_allocator_t* allocator, size_t size) {
+  return frag_alloc(allocator, size);
+}
+
+static void* alloc_from_site_b(frag_allocator_t* allocator, size_t size) {
+  return frag_alloc(allocator, size);
+}
+
+TEST_CASE("frag_snapshot", "[snapshot]") {
+  frag_config_t config;
+  frag_config_init(&config);
+  config.enable_detailed_leak_reports = true;
+  init_t init(&config);
+  frag_allocator_t* system = frag_system_allocator();
+  frag_allocator_t* group = frag_group_allocator_create(system, "group", true, system);
+  DEFER([&] {
+    frag_allocator_destroy(system, group);
+  });
+
+  SECTION("it captures the live allocations") {
+    frag_snapshot_t* before = frag_snapshot_take();
+    void* ptr = frag_alloc(group, 100);
+    frag_snapshot_t* after = frag_snapshot_take();
+
+    size_t count_before;
+    size_t count_after;
+    frag_snapshot_totals(before, &count_before, nullptr);
+    frag_snapshot_totals(after, &count_after, nullptr);
+    // the group allocation also shows up in the system allocator it passes through to
+    CHECK(count_after == count_before + 2);
+
+    frag_snapshot_free(after);
+    frag_snapshot_free(before);
+    frag_free(group, ptr);
+  }
+
+  SECTION("it reports new allocations grouped by site") {
+    void* old_ptr = alloc_from_site_a(group, 64);
+    frag_snapshot_t* before = frag_snapshot_take();
+
+    void* ptrs[5];
+    for (int index = 0; index < 3; ++index) {
+      ptrs[index] = alloc_from_site_a(group, 64);
+    }
+    for (int index = 3; index < 5; ++index) {
+      ptrs[index] = alloc_from_site_b(group, 512);
+    }
+    frag_free(group, old_ptr);
+    frag_snapshot_t* after = frag_snapshot_take();
+
+    frag_snapshot_diff_t* diff = frag_snapshot_diff(before, after);
+    frag_snapshot_free(after);
+    frag_snapshot_free(before);
+
+    // both the group and the system allocator see each allocation
+    REQUIRE(diff->site_count == 4);
+    CHECK(diff->count == 10);
+    CHECK(diff->sites[0].bytes >= diff->sites[1].bytes);
+    unsigned int group_sites = 0;
+    for (unsigned int index = 0; index < diff->site_count; ++index) {
+      const frag_snapshot_site_t* site = diff->sites + index;
+      if (strcmp(site->allocator_name, "group") != 0) {
+        continue;
+      }
+      ++group_sites;
+      if (strcmp(site->func, "alloc_from_site_a") == 0) {
+        CHECK(site->count == 3);
+      }
+      else {
+        CHECK(strcmp(site->func, "alloc_from_site_b") == 0);
+        CHECK(site->count == 2);
+      }
+    }
+    CHECK(group_sites == 2);
+    frag_snapshot_diff_free(diff);
+
+    for (void* ptr : ptrs) {
+      frag_free(group, ptr);
+    }
+  }
+
+  SECTION("it outlives the allocators it captured") {
+    frag_allocator_t* temp = frag_group_allocator_create(system, "temp", true, system);
+    frag_snapshot_t* before = frag_snapshot_take();
+    void* ptr = frag_alloc(temp, 16);
+    frag_snapshot_t* after = frag_snapshot_take();
+    frag_free(temp, ptr);
+    frag_allocator_destroy(system, temp);
+
+    frag_snapshot_diff_t* diff = frag_snapshot_diff(before, after);
+    bool found = false;
+    for (unsigned int index = 0; index < diff->site_count; ++index) {
+      found = found || strcmp(diff->sites[index].allocator_name, "temp") == 0;
+    }
+    CHECK(found);
+    frag_snapshot_diff_free(diff);
+    frag_snapshot_free(after);
+    frag_snapshot_free(before);
+  }
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "utils.h"
+
+static std::string read_file(const char* path) {
+  std::string contents;
+  FILE* file = fopen(path, "r");
+  if (file != nullptr) {
+    char buf[4096];
+    size_t count;
+    while ((count = fread(buf, 1, sizeof(buf), file)) > 0) {
+      contents.append(buf, count);
+    }
+    fclose(file);
+  }
+  return contents;
+}
+
+static size_t count_occurrences(const std::string& str, const std::string& pattern) {
+  size_t count = 0;
+  for (size_t pos = str.find(pattern); pos != std::string::npos; pos = str.find(pattern, pos + pattern.size())) {
+    ++count;
+  }
+  return count;
+}
+
+TEST_CASE("frag_trace", "[trace]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/frag_spec_trace_%d.json", (int)getpid());
+  DEFER([&] { unlink(path); });
+
+  SECTION("it records allocations from every thread") {
+    frag_allocator_t* group = frag_group_allocator_create(system, "traced \"group\"", true, system);
+    REQUIRE(frag_trace_start(path, 1));
+    std::thread threads[4];
+    for (std::thread& thread : threads) {
+      thread = std::thread([group] {
+        for (int index = 0; index < 100; ++index) {
+          frag_free(group, frag_alloc(group, 64));
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    frag_allocator_destroy(system, group);
+    frag_trace_stop();
+
+    const std::string trace = read_file(path);
+    CHECK(trace.compare(0, 2, "{\"") == 0);
+    CHECK(trace.compare(trace.size() - 4, 4, "\n]}\n") == 0);
+    CHECK(count_occurrences(trace, "\"name\":\"alloc\",\"cat\":\"frag\",\"ph\":\"i\"") >= 400);
+    CHECK(count_occurrences(trace, "\"allocator\":\"traced \\\"group\\\"\"") >= 800);
+    CHECK(count_occurrences(trace, "\"ph\":\"C\"") > 0);
+  }
+
+  SECTION("it records frame resets") {
+    char buf[1024];
+    frag_allocator_t* frame = frag_frame_allocator_create(system, "frame", true, buf, sizeof(buf), 2);
+    REQUIRE(frag_trace_start(path, 1000));
+    frag_free(frame, frag_alloc(frame, 16));
+    frag_frame_allocator_advance(frame);
+    frag_frame_allocator_advance(frame);
+    frag_trace_stop();
+    frag_allocator_destroy(system, frame);
+
+    const std::string trace = read_file(path);
+    CHECK(count_occurrences(trace, "\"name\":\"reset\"") == 2);
+    CHECK(count_occurrences(trace, "\"name\":\"free\"") == 1);
+  }
+
+  SECTION("it records nothing once stopped") {
+    REQUIRE(frag_trace_start(path, 1000));
+    frag_trace_stop();
+    frag_free(system, frag_alloc(system, 16));
+    const std::string trace = read_file(path);
+    CHECK(count_occurrences(trace, "\"name\":\"alloc\"") == 0);
+  }
+}
@@ -0,0 +1,129 @@
+#include <stdint.h>
+#include <string.h>
+#include "utils.h"
+
+TEST_CASE("vm_stack allocator", "[vm_stack]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  const size_t reserve_size = 64 * 1024 * 1024;
+  frag_allocator_t* allocator = frag_vm_stack_allocator_create(system, "woot", true, reserve_size, SIZE_MAX);
+  DEFER([&] {
+    frag_allocator_destroy(system, allocator);
+  });
+
+  SECTION("it can allocate properly aligned memory") {
+    void* ptr = frag_alloc_aligned(allocator, 16, 64);
+    REQUIRE(is_aligned_ptr(ptr, 64));
+    frag_free(allocator, ptr);
+  }
+
+  SECTION("it allocates memory with sequential addresses") {
+    void* ptr1 = frag_alloc_aligned(allocator, 16, 16);
+    void* ptr2 = frag_alloc_aligned(allocator, 32, 8);
+    void* ptr3 = frag_alloc_aligned(allocator, 23, 128);
+    REQUIRE(is_aligned_ptr(ptr1, 16));
+    REQUIRE(is_aligned_ptr(ptr2, 8));
+    REQUIRE(is_aligned_ptr(ptr3, 128));
+
+    REQUIRE((uintptr_t)ptr2 > (uintptr_t)ptr1);
+    REQUIRE((uintptr_t)ptr3 > (uintptr_t)ptr2);
+
+    frag_free(allocator, ptr3);
+    frag_free(allocator, ptr2);
+    frag_free(allocator, ptr1);
+  }
+
+  SECTION("it commits memory on demand as it grows") {
+    char* ptr1 = (char*)frag_alloc(allocator, 1024);
+    char* ptr2 = (char*)frag_alloc(allocator, 8 * 1024 * 1024);
+    char* ptr3 = (char*)frag_alloc(allocator, 1024);
+    memset(ptr1, 1, 1024);
+    memset(ptr2, 2, 8 * 1024 * 1024);
+    memset(ptr3, 3, 1024);
+    CHECK(ptr1[1023] == 1);
+    CHECK(ptr2[8 * 1024 * 1024 - 1] == 2);
+    CHECK(ptr3[0] == 3);
+    frag_free(allocator, ptr3);
+    frag_free(allocator, ptr2);
+    frag_free(allocator, ptr1);
+  }
+
+  SECTION("it returns committed pages above the top of the stack when trimmed") {
+    void* ptr1 = frag_alloc(allocator, 1024);
+    void* ptr2 = frag_alloc(allocator, 4 * 1024 * 1024);
+    memset(ptr2, 0xff, 4 * 1024 * 1024);
+    frag_free(allocator, ptr2);
+    CHECK(frag_allocator_trim(allocator, 0) >= 4 * 1024 * 1024);
+    CHECK(frag_allocator_trim(allocator, 0) == 0);
+
+    // the memory is committed again when needed
+    char* ptr3 = (char*)frag_alloc(allocator, 4 * 1024 * 1024);
+    memset(ptr3, 0xff, 4 * 1024 * 1024);
+    frag_free(allocator, ptr3);
+    frag_free(allocator, ptr1);
+  }
+
+  SECTION("it returns zeroed memory when reusing dirty memory") {
+    const size_t size = 256 * 1024;
+    char* ptr1 = (char*)frag_alloc(allocator, size);
+    memset(ptr1, 0xff, size);
+    frag_free(allocator, ptr1);
+
+    char* ptr2 = (char*)frag_alloc_zero(allocator, 2 * size);
+    CHECK(ptr2 == ptr1);
+    bool is_zero = true;
+    for (size_t index = 0; index < 2 * size; ++index) {
+      is_zero = is_zero && ptr2[index] == 0;
+    }
+    CHECK(is_zero);
+    frag_free(allocator, ptr2);
+  }
+
+  SECTION("it fails when the reservation is exhausted") {
+    CHECK_THROWS(frag_alloc(allocator, reserve_size + 1));
+  }
+}
+
+TEST_CASE("vm_stack allocator decommits on free", "[vm_stack]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  frag_allocator_t* allocator = frag_vm_stack_allocator_create(system, "woot", true, 64 * 1024 * 1024, 64 * 1024);
+  DEFER([&] {
+    frag_allocator_destroy(system, allocator);
+  });
+
+  SECTION("it keeps only the slack committed above the top of the stack") {
+    void* ptr1 = frag_alloc(allocator, 1024);
+    void* ptr2 = frag_alloc(allocator, 4 * 1024 * 1024);
+    memset(ptr2, 0xff, 4 * 1024 * 1024);
+    frag_free(allocator, ptr2);
+    CHECK(frag_allocator_trim(allocator, 64 * 1024) == 0);
+    frag_free(allocator, ptr1);
+  }
+}
+
+TEST_CASE("vm_stack allocator detects memory leaks", "[vm_stack]") {
+  init_t init(nullptr);
+  frag_allocator_t* system = frag_system_allocator();
+
+  frag_allocator_t* allocator = frag_vm_stack_allocator_create(system, "woot", true, 1024 * 1024, SIZE_MAX);
+  DEFER([&] {
+    frag_allocator_destroy(system, allocator);
+  });
+
+  SECTION("it detects memory leaks on shutdown") {
+    void* ptr = frag_alloc_aligned(allocator, 16, 32);
+    CHECK_THROWS(frag_allocator_destroy(system, allocator));
+    frag_free(allocator, ptr);
+  }
+
+  SECTION("it asserts when freeing a pointer that's not on top") {
+    void* ptr1 = frag_alloc_aligned(allocator, 8, 8);
+    void* ptr2 = frag_alloc_aligned(allocator, 16, 16);
+    CHECK_THROWS(frag_free(allocator, ptr1));
+    frag_free(allocator, ptr2);
+    frag_free(allocator, ptr1);
+  }
+}
@@ -0,0 +1,346 @@
+#include "internal.h"
+
+// Each node in the tree holds the order of the largest free block below it plus one (so zero means nothing is free). A
+// node whose whole range is free holds its own full order. The tree is laid out as a 1-based binary heap where the root
+// covers the whole range and leaves cover a single minimum sized block.
+
+static unsigned int log2_floor(size_t x) {
+  unsigned int result = 0;
+  while (x >>= 1) {
+    ++result;
+  }
+  return result;
+}
+
+static size_t pow_2_ceil(size_t x) {
+  size_t result = 1;
+  while (result < x) {
+    result <<= 1;
+  }
+  return result;
+}
+
+static uint8_t full_value(const buddy_t* buddy, size_t node) {
+  return (uint8_t)(buddy->level_count - log2_floor(node));
+}
+
+static void update_parents(buddy_t* buddy, size_t node) {
+  while (node > 1) {
+    node >>= 1;
+    const uint8_t left = buddy->tree[node * 2];
+    const uint8_t right = buddy->tree[node * 2 + 1];
+    const uint8_t full = full_value(buddy, node);
+    if (left == full - 1 && right == full - 1) {
+      buddy->tree[node] = full;
+    }
+    else {
+      buddy->tree[node] = left > right ? left : right;
+    }
+  }
+}
+
+static size_t node_offset(const buddy_t* buddy, size_t node) {
+  const unsigned int level = log2_floor(node);
+  const size_t block_size = buddy_node_size(buddy, node);
+  return (node - ((size_t)1 << level)) * block_size;
+}
+
+size_t buddy_node_size(const buddy_t* buddy, size_t node) {
+  return ((size_t)1 << buddy->leaf_shift) << (full_value(buddy, node) - 1);
+}
+
+// Finds the node for the allocation at the given offset. Returns zero if there isn't one.
+static size_t find_alloc_node(const buddy_t* buddy, size_t offset) {
+  const size_t leaf_count = (size_t)1 << (buddy->level_count - 1);
+  const size_t leaf = offset >> buddy->leaf_shift;
+  if (offset >= buddy->size || (offset & (((size_t)1 << buddy->leaf_shift) - 1)) != 0) {
+    return 0;
+  }
+
+  // allocated nodes hold zero while everything below them was left fully free, so the first zero on the way up is it
+  size_t node = leaf_count + leaf;
+  while (node > 0 && buddy->tree[node] != 0) {
+    node >>= 1;
+  }
+  if (node == 0 || node_offset(buddy, node) != offset) {
+    return 0;
+  }
+  return node;
+}
+
+size_t buddy_metadata_size(size_t size, size_t min_block_size) {
+  const size_t leaf_count = pow_2_ceil((size + min_block_size - 1) / min_block_size);
+  return 2 * leaf_count * sizeof(uint8_t);
+}
+
+void buddy_init(buddy_t* buddy, uint8_t* tree, size_t size, size_t min_block_size, bool reset) {
+  const size_t leaf_count = pow_2_ceil((size + min_block_size - 1) / min_block_size);
+  buddy->tree = tree;
+  buddy->size = size;
+  buddy->leaf_shift = log2_floor(min_block_size);
+  buddy->level_count = log2_floor(leaf_count) + 1;
+  if (!reset) {
+    return;
+  }
+
+  // the tree is rounded up to a power of 2 so leaves past the end of the range are treated as permanently allocated
+  tree[0] = 0;
+  for (size_t leaf = 0; leaf < leaf_count; ++leaf) {
+    const size_t leaf_end = (leaf + 1) * min_block_size;
+    tree[leaf_count + leaf] = leaf_end <= size ? 1 : 0;
+  }
+  for (size_t node = leaf_count - 1; node > 0; --node) {
+    const uint8_t left = tree[node * 2];
+    const uint8_t right = tree[node * 2 + 1];
+    const uint8_t full = full_value(buddy, node);
+    if (left == full - 1 && right == full - 1) {
+      tree[node] = full;
+    }
+    else {
+      tree[node] = left > right ? left : right;
+    }
+  }
+}
+
+bool buddy_alloc(buddy_t* buddy, size_t size, size_t alignment, size_t* offset, size_t* block_size) {
+  // blocks are aligned to their size, so asking for a big enough block takes care of the alignment
+  size_t size_needed = size > alignment ? size : alignment;
+  const size_t min_block_size = (size_t)1 << buddy->leaf_shift;
+  if (size_needed < min_block_size) {
+    size_needed = min_block_size;
+  }
+  if (size_needed > (min_block_size << (buddy->level_count - 1))) {
+    return false;
+  }
+  const uint8_t value = (uint8_t)(log2_floor(pow_2_ceil(size_needed) >> buddy->leaf_shift) + 1);
+  if (buddy->tree[1] < value) {
+    return false;
+  }
+
+  // walk down preferring the child with the smallest block that still fits to keep large blocks intact
+  size_t node = 1;
+  while (full_value(buddy, node) != value) {
+    const uint8_t left = buddy->tree[node * 2];
+    const uint8_t right = buddy->tree[node * 2 + 1];
+    if (left >= value && (right < value || left <= right)) {
+      node = node * 2;
+    }
+    else {
+      node = node * 2 + 1;
+    }
+  }
+
+  buddy->tree[node] = 0;
+  update_parents(buddy, node);
+
+  *offset = node_offset(buddy, node);
+  *block_size = buddy_node_size(buddy, node);
+  return true;
+}
+
+size_t buddy_free(buddy_t* buddy, size_t offset) {
+  const size_t node = find_alloc_node(buddy, offset);
+  if (!frag_assert(node != 0, "tried to free an invalid pointer")) {
+    return 0;
+  }
+
+  // mark the block as free again and coalesce with its buddies on the way up
+  buddy->tree[node] = full_value(buddy, node);
+  update_parents(buddy, node);
+  return buddy_node_size(buddy, node);
+}
+
+size_t buddy_free_sized(buddy_t* buddy, size_t offset, size_t size, size_t alignment) {
+  // the size and alignment pick out the level the block was allocated at, so there's no need to search for it
+  size_t size_needed = size > alignment ? size : alignment;
+  const size_t min_block_size = (size_t)1 << buddy->leaf_shift;
+  if (size_needed < min_block_size) {
+    size_needed = min_block_size;
+  }
+  const unsigned int level_from_leaf = log2_floor(pow_2_ceil(size_needed) >> buddy->leaf_shift);
+  const size_t leaf_count = (size_t)1 << (buddy->level_count - 1);
+  if (!frag_assert(offset < buddy->size && level_from_leaf < buddy->level_count, "tried to free an invalid pointer")) {
+    return 0;
+  }
+  const size_t node = (leaf_count + (offset >> buddy->leaf_shift)) >> level_from_leaf;
+  const bool is_alloc = node_offset(buddy, node) == offset && buddy->tree[node] == 0 && (level_from_leaf == 0 || buddy->tree[node * 2] != 0);
+  if (!frag_assert(is_alloc, "tried to free with the wrong size")) {
+    return 0;
+  }
+
+  buddy->tree[node] = full_value(buddy, node);
+  update_parents(buddy, node);
+  return buddy_node_size(buddy, node);
+}
+
+void buddy_repair(buddy_t* buddy) {
+  // Rebuilds every node above the leaves from its children, for when an update to the parents was cut short. A node
+  // that's zero while both children are fully free is an allocation and is left alone. Nothing else can look like that
+  // part way through an update because only one node changes before its parents are refreshed.
+  const size_t leaf_count = (size_t)1 << (buddy->level_count - 1);
+  for (size_t node = leaf_count - 1; node > 0; --node) {
+    const uint8_t left = buddy->tree[node * 2];
+    const uint8_t right = buddy->tree[node * 2 + 1];
+    const uint8_t full = full_value(buddy, node);
+    if (left == full - 1 && right == full - 1) {
+      if (buddy->tree[node] != 0) {
+        buddy->tree[node] = full;
+      }
+    }
+    else {
+      buddy->tree[node] = left > right ? left : right;
+    }
+  }
+}
+
+size_t buddy_block_size(const buddy_t* buddy, size_t offset) {
+  const size_t node = find_alloc_node(buddy, offset);
+  if (!frag_assert(node != 0, "tried to free an invalid pointer")) {
+    return 0;
+  }
+  return buddy_node_size(buddy, node);
+}
+
+static void query_layout_node(const buddy_t* buddy, size_t node, frag_allocator_layout_t* layout) {
+  const uint8_t full = full_value(buddy, node);
+  const size_t block_size = buddy_node_size(buddy, node);
+  frag_size_class_t* size_class = &layout->size_classes[full - 1];
+  if (buddy->tree[node] == full) {
+    size_class->free_count++;
+    layout->free_bytes += block_size;
+    layout->free_block_count++;
+    if (block_size > layout->largest_free_block) {
+      layout->largest_free_block = block_size;
+    }
+    return;
+  }
+
+  // a zero is either an allocation (which leaves everything below it free) or a node that's used up further down
+  const bool is_leaf = full == 1;
+  if (buddy->tree[node] == 0 && (is_leaf || buddy->tree[node * 2] != 0)) {
+    // leaves past the end of the range are zero too but were never handed out
+    if (node_offset(buddy, node) + block_size <= buddy->size) {
+      size_class->used_count++;
+    }
+    return;
+  }
+  if (!is_leaf) {
+    query_layout_node(buddy, node * 2, layout);
+    query_layout_node(buddy, node * 2 + 1, layout);
+  }
+}
+
+void buddy_query_layout(const buddy_t* buddy, frag_allocator_layout_t* layout) {
+  const size_t min_block_size = (size_t)1 << buddy->leaf_shift;
+  layout->committed_bytes = buddy->size & ~(min_block_size - 1);
+  layout->size_class_count = buddy->level_count < FRAG_LAYOUT_MAX_SIZE_CLASSES ? buddy->level_count : FRAG_LAYOUT_MAX_SIZE_CLASSES;
+  for (unsigned int index = 0; index < layout->size_class_count; ++index) {
+    layout->size_classes[index].block_size = min_block_size << index;
+  }
+  query_layout_node(buddy, 1, layout);
+}
+
+static void for_each_alloc_node(const buddy_t* buddy, size_t node, buddy_alloc_func_t func, void* user_data) {
+  const uint8_t full = full_value(buddy, node);
+  if (buddy->tree[node] == full) {
+    return;
+  }
+
+  // same as query_layout_node(), a zero with anything free below it is an allocation
+  const size_t block_size = buddy_node_size(buddy, node);
+  const bool is_leaf = full == 1;
+  if (buddy->tree[node] == 0 && (is_leaf || buddy->tree[node * 2] != 0)) {
+    const size_t offset = node_offset(buddy, node);
+    if (offset + block_size <= buddy->size) {
+      func(offset, block_size, user_data);
+    }
+    return;
+  }
+  if (!is_leaf) {
+    for_each_alloc_node(buddy, node * 2, func, user_data);
+    for_each_alloc_node(buddy, node * 2 + 1, func, user_data);
+  }
+}
+
+void buddy_for_each_alloc(const buddy_t* buddy, buddy_alloc_func_t func, void* user_data) {
+  for_each_alloc_node(buddy, 1, func, user_data);
+}
+
+typedef struct buddy_allocator_impl_t {
+  buddy_t buddy;
+  char* base;
+} buddy_allocator_impl_t;
+
+static size_t buddy_allocator_get_size(const frag_allocator_t* allocator, void* ptr) {
+  const buddy_allocator_impl_t* impl = (const buddy_allocator_impl_t*)allocator->impl;
+  return buddy_block_size(&impl->buddy, (size_t)((char*)ptr - impl->base));
+}
+
+static void* buddy_allocator_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  buddy_allocator_impl_t* impl = (buddy_allocator_impl_t*)allocator->impl;
+  frag_assert(is_pow_2(alignment), "alignment is not a power of 2");
+  frag_assert(((uintptr_t)impl->base & (alignment - 1)) == 0, "range base is not aligned enough for the requested alignment");
+
+  size_t offset;
+  if (!buddy_alloc(&impl->buddy, size, alignment, &offset, size_allocated)) {
+    *size_allocated = 0;
+    return NULL;
+  }
+  return impl->base + offset;
+}
+
+static void buddy_allocator_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
+  buddy_allocator_impl_t* impl = (buddy_allocator_impl_t*)allocator->impl;
+  buddy_free(&impl->buddy, (size_t)((char*)ptr - impl->base));
+}
+
+static size_t buddy_allocator_free_sized(frag_allocator_t* allocator, void* ptr, size_t size, size_t alignment, const char* file, int line, const char* func) {
+  buddy_allocator_impl_t* impl = (buddy_allocator_impl_t*)allocator->impl;
+  return buddy_free_sized(&impl->buddy, (size_t)((char*)ptr - impl->base), size, alignment);
+}
+
+static void buddy_allocator_query_layout(const frag_allocator_t* allocator, frag_allocator_layout_t* layout) {
+  const buddy_allocator_impl_t* impl = (const buddy_allocator_impl_t*)allocator->impl;
+  buddy_query_layout(&impl->buddy, layout);
+}
+
+static void buddy_allocator_shutdown(frag_allocator_t* allocator) {
+  buddy_allocator_impl_t* impl = (buddy_allocator_impl_t*)allocator->impl;
+  allocator_free(allocator->owner, impl->buddy.tree, __FILE__, __LINE__, __func__);
+}
+
+frag_allocator_t* buddy_create(frag_allocator_t* owner, const char* name, bool needs_lock, void* base, size_t size, size_t min_block_size) {
+  if (!frag_assert(is_pow_2(min_block_size), "minimum block size is not a power of 2") ||
+      !frag_assert(size >= min_block_size, "range is smaller than the minimum block size")) {
+    return NULL;
+  }
+
+  frag_allocator_desc_t desc = {0};
+  desc.name = name;
+  desc.needs_lock = needs_lock;
+  desc.alloc = &buddy_allocator_alloc;
+  desc.free = &buddy_allocator_free;
+  desc.get_size = &buddy_allocator_get_size;
+  desc.shutdown = &buddy_allocator_shutdown;
+  desc.free_sized = &buddy_allocator_free_sized;
+  desc.query_layout = &buddy_allocator_query_layout;
+  desc.impl_size_bytes = sizeof(buddy_allocator_impl_t);
+  frag_allocator_t* allocator = allocator_create(owner, &desc);
+
+  // all of the bookkeeping lives in the owner so the managed range is never touched
+  size_t size_allocated;
+  const size_t metadata_size = buddy_metadata_size(size, min_block_size);
+  uint8_t* tree = (uint8_t*)allocator_alloc(owner, metadata_size, 0, __FILE__, __LINE__, __func__, &size_allocated);
+
+  buddy_allocator_impl_t* impl = (buddy_allocator_impl_t*)allocator->impl;
+  impl->buddy.tree = tree;
+  if (tree == NULL) {
+    allocator_shutdown(allocator);
+    allocator_free(owner, allocator, __FILE__, __LINE__, __func__);
+    return NULL;
+  }
+  impl->base = (char*)base;
+  buddy_init(&impl->buddy, tree, size, min_block_size, true);
+
+  return allocator;
+}
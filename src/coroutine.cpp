@@ -0,0 +1,139 @@
+#include <mutex>
+#include "frag.h"
+#include "internal.h"
+
+// frames are recycled in size classes of this many bytes
+#define COROUTINE_FRAME_CLASS_BYTES 64
+
+// frames bigger than COROUTINE_FRAME_CLASS_BYTES * COROUTINE_FRAME_CLASS_COUNT aren't pooled
+#define COROUTINE_FRAME_CLASS_COUNT 64
+
+// how many free frames of each size class a thread holds on to
+#define COROUTINE_FRAME_CACHE_COUNT 32
+
+struct frame_free_t {
+  frame_free_t* next;
+};
+
+// The frames a thread has freed, ready for it to reuse. Only the owning thread touches the free lists while frag is
+// running. The list of pools is only there so frag_lib_shutdown() can hand everything back.
+struct frame_pool_t {
+  ~frame_pool_t();
+
+  frame_free_t* free_lists[COROUTINE_FRAME_CLASS_COUNT];
+  unsigned int free_counts[COROUTINE_FRAME_CLASS_COUNT];
+  bool registered;
+  frame_pool_t* prev;
+  frame_pool_t* next;
+};
+
+static std::mutex s_pools_mutex;
+static frame_pool_t* s_pools;
+
+static thread_local frame_pool_t t_pool;
+
+static size_t pool_release(frame_pool_t* pool) {
+  frag_allocator_t* system = frag_system_allocator();
+  size_t released = 0;
+  for (unsigned int index = 0; index < COROUTINE_FRAME_CLASS_COUNT; ++index) {
+    while (pool->free_lists[index] != nullptr) {
+      frame_free_t* frame = pool->free_lists[index];
+      pool->free_lists[index] = frame->next;
+      frag_free(system, frame);
+      released += (index + 1) * (size_t)COROUTINE_FRAME_CLASS_BYTES;
+    }
+    pool->free_counts[index] = 0;
+  }
+  return released;
+}
+
+static void pool_unregister(frame_pool_t* pool) {
+  if (pool->prev != nullptr) {
+    pool->prev->next = pool->next;
+  }
+  else {
+    s_pools = pool->next;
+  }
+  if (pool->next != nullptr) {
+    pool->next->prev = pool->prev;
+  }
+  pool->prev = nullptr;
+  pool->next = nullptr;
+  pool->registered = false;
+}
+
+frame_pool_t::~frame_pool_t() {
+  std::lock_guard<std::mutex> lock(s_pools_mutex);
+  if (registered) {
+    pool_release(this);
+    pool_unregister(this);
+  }
+}
+
+static frame_pool_t* pool_get() {
+  frame_pool_t* pool = &t_pool;
+  if (!pool->registered) {
+    std::lock_guard<std::mutex> lock(s_pools_mutex);
+    pool->registered = true;
+    pool->prev = nullptr;
+    pool->next = s_pools;
+    if (s_pools != nullptr) {
+      s_pools->prev = pool;
+    }
+    s_pools = pool;
+  }
+  return pool;
+}
+
+void* frag_coroutine_frame_alloc(size_t size) {
+  const size_t index = (size + COROUTINE_FRAME_CLASS_BYTES - 1) / COROUTINE_FRAME_CLASS_BYTES - 1;
+  if (size == 0 || index >= COROUTINE_FRAME_CLASS_COUNT) {
+    return frag_alloc(frag_system_allocator(), size);
+  }
+
+  frame_pool_t* pool = pool_get();
+  frame_free_t* frame = pool->free_lists[index];
+  if (frame != nullptr) {
+    pool->free_lists[index] = frame->next;
+    --pool->free_counts[index];
+    return frame;
+  }
+  return frag_alloc(frag_system_allocator(), (index + 1) * COROUTINE_FRAME_CLASS_BYTES);
+}
+
+void frag_coroutine_frame_free(void* ptr, size_t size) {
+  if (ptr == NULL) {
+    return;
+  }
+  const size_t index = (size + COROUTINE_FRAME_CLASS_BYTES - 1) / COROUTINE_FRAME_CLASS_BYTES - 1;
+  if (size == 0 || index >= COROUTINE_FRAME_CLASS_COUNT) {
+    frag_free(frag_system_allocator(), ptr);
+    return;
+  }
+
+  frame_pool_t* pool = pool_get();
+  if (pool->free_counts[index] >= COROUTINE_FRAME_CACHE_COUNT) {
+    frag_free(frag_system_allocator(), ptr);
+    return;
+  }
+  frame_free_t* frame = (frame_free_t*)ptr;
+  frame->next = pool->free_lists[index];
+  pool->free_lists[index] = frame;
+  ++pool->free_counts[index];
+}
+
+size_t frag_coroutine_frame_pool_trim() {
+  std::lock_guard<std::mutex> lock(s_pools_mutex);
+  frame_pool_t* pool = &t_pool;
+  return pool->registered ? pool_release(pool) : 0;
+}
+
+void coroutine_shutdown() {
+  // every thread's cached frames belong to the system allocator, so they have to go back before it is destroyed
+  std::lock_guard<std::mutex> lock(s_pools_mutex);
+  while (s_pools != nullptr) {
+    frame_pool_t* pool = s_pools;
+    pool_release(pool);
+    pool_unregister(pool);
+  }
+}
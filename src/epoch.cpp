@@ -0,0 +1,340 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include "frag.h"
+#include "internal.h"
+
+// how many retired blocks a thread collects before handing them off to be freed
+#define EPOCH_BATCH_SIZE 64
+
+struct epoch_retired_t {
+  frag_allocator_t* allocator;
+  void* ptr;
+  const char* file;
+  const char* func;
+  int line;
+};
+
+struct epoch_batch_t {
+  epoch_batch_t* next;
+  uint64_t epoch;
+  unsigned int count;
+  epoch_retired_t retired[EPOCH_BATCH_SIZE];
+};
+
+struct epoch_thread_t {
+  // the epoch this thread entered shifted up by one, with the low bit set while it is inside a read-side section
+  std::atomic<uint64_t> state;
+  std::atomic<bool> in_use;
+  epoch_thread_t* next;
+  unsigned int nesting;
+  epoch_batch_t* batch;
+};
+
+// releases the thread's record when the thread exits
+struct epoch_thread_guard_t {
+  ~epoch_thread_guard_t();
+
+  epoch_thread_t* thread = nullptr;
+  uint64_t generation = 0;
+};
+
+static std::atomic<uint64_t> s_epoch(0);
+static std::atomic<epoch_thread_t*> s_threads(nullptr);
+static std::atomic<epoch_batch_t*> s_pending(nullptr);
+static std::mutex s_collect_mutex;
+
+// bumped whenever the library shuts down so threads know their record is gone
+static std::atomic<uint64_t> s_generation(1);
+
+static std::mutex s_reclaimer_mutex;
+static std::condition_variable s_reclaimer_cond;
+static std::thread s_reclaimer;
+static bool s_reclaimer_stop = false;
+static std::atomic<bool> s_reclaimer_running(false);
+
+static thread_local epoch_thread_guard_t t_thread;
+
+static void push_batches(epoch_batch_t* first, epoch_batch_t* last) {
+  epoch_batch_t* head = s_pending.load();
+  do {
+    last->next = head;
+  } while (!s_pending.compare_exchange_weak(head, first));
+}
+
+static void seal_batch(epoch_thread_t* thread) {
+  epoch_batch_t* batch = thread->batch;
+  if (batch == nullptr) {
+    return;
+  }
+
+  // everything in the batch was unlinked before now so it is safe to free once the epoch has moved on twice
+  batch->epoch = s_epoch.load();
+  thread->batch = nullptr;
+  push_batches(batch, batch);
+}
+
+static void free_batch(epoch_batch_t* batch) {
+  for (unsigned int index = 0; index < batch->count; ++index) {
+    const epoch_retired_t* retired = batch->retired + index;
+    allocator_free(retired->allocator, retired->ptr, retired->file, retired->line, retired->func);
+  }
+  frag_free(frag_metadata_allocator(), batch);
+}
+
+static epoch_thread_t* get_thread() {
+  const uint64_t generation = s_generation.load();
+  if (t_thread.thread != nullptr && t_thread.generation == generation) {
+    return t_thread.thread;
+  }
+
+  // reuse a record left behind by a thread that has exited before making a new one
+  epoch_thread_t* thread = s_threads.load();
+  for (; thread != nullptr; thread = thread->next) {
+    bool in_use = false;
+    if (thread->in_use.compare_exchange_strong(in_use, true)) {
+      break;
+    }
+  }
+  if (thread == nullptr) {
+    thread = frag_new(frag_metadata_allocator(), epoch_thread_t);
+    if (thread == nullptr) {
+      // already reported as out of memory
+      return nullptr;
+    }
+    thread->state.store(0);
+    thread->in_use.store(true);
+    thread->nesting = 0;
+    thread->batch = nullptr;
+    thread->next = s_threads.load();
+    while (!s_threads.compare_exchange_weak(thread->next, thread)) {
+    }
+  }
+
+  t_thread.thread = thread;
+  t_thread.generation = generation;
+  return thread;
+}
+
+epoch_thread_guard_t::~epoch_thread_guard_t() {
+  if (thread == nullptr || generation != s_generation.load()) {
+    return;
+  }
+  seal_batch(thread);
+  thread->nesting = 0;
+  thread->state.store(0);
+  thread->in_use.store(false);
+}
+
+static bool try_advance() {
+  // the epoch can only move on once every thread inside a read-side section has seen the current one
+  uint64_t epoch = s_epoch.load();
+  for (epoch_thread_t* thread = s_threads.load(); thread != nullptr; thread = thread->next) {
+    const uint64_t state = thread->state.load();
+    if ((state & 1) != 0 && (state >> 1) != epoch) {
+      return false;
+    }
+  }
+  return s_epoch.compare_exchange_strong(epoch, epoch + 1);
+}
+
+static void collect(bool wait) {
+  std::unique_lock<std::mutex> lock(s_collect_mutex, std::defer_lock);
+  if (wait) {
+    lock.lock();
+  }
+  else if (!lock.try_lock()) {
+    // someone else is already collecting
+    return;
+  }
+
+  try_advance();
+  const uint64_t epoch = s_epoch.load();
+
+  epoch_batch_t* batch = s_pending.exchange(nullptr);
+  epoch_batch_t* keep_first = nullptr;
+  epoch_batch_t* keep_last = nullptr;
+  while (batch != nullptr) {
+    epoch_batch_t* next = batch->next;
+    if (batch->epoch + 2 <= epoch) {
+      free_batch(batch);
+    }
+    else {
+      batch->next = keep_first;
+      keep_first = batch;
+      if (keep_last == nullptr) {
+        keep_last = batch;
+      }
+    }
+    batch = next;
+  }
+  if (keep_first != nullptr) {
+    push_batches(keep_first, keep_last);
+  }
+}
+
+static void reclaimer_main(unsigned int interval_msec) {
+  std::unique_lock<std::mutex> lock(s_reclaimer_mutex);
+  while (!s_reclaimer_stop) {
+    s_reclaimer_cond.wait_for(lock, std::chrono::milliseconds(interval_msec));
+    lock.unlock();
+    collect(true);
+    lock.lock();
+  }
+}
+
+void epoch_shutdown() {
+  frag_epoch_reclaimer_stop();
+
+  // nobody can be reading anymore so everything that's left can go
+  for (epoch_thread_t* thread = s_threads.load(); thread != nullptr; thread = thread->next) {
+    seal_batch(thread);
+  }
+  epoch_batch_t* batch = s_pending.exchange(nullptr);
+  while (batch != nullptr) {
+    epoch_batch_t* next = batch->next;
+    free_batch(batch);
+    batch = next;
+  }
+
+  epoch_thread_t* thread = s_threads.exchange(nullptr);
+  while (thread != nullptr) {
+    epoch_thread_t* next = thread->next;
+    frag_delete(frag_metadata_allocator(), thread);
+    thread = next;
+  }
+  s_epoch.store(0);
+  s_generation.fetch_add(1);
+}
+
+// Waits until every other thread has left the read-side section it was in when this was called. Unlike advancing the
+// epoch this works while the calling thread is inside a section itself.
+static void wait_for_readers(const epoch_thread_t* self) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  for (epoch_thread_t* thread = s_threads.load(); thread != nullptr; thread = thread->next) {
+    const uint64_t state = thread->state.load();
+    if (thread == self || (state & 1) == 0) {
+      continue;
+    }
+    while (thread->state.load() == state) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void frag_epoch_enter() {
+  epoch_thread_t* thread = get_thread();
+  if (thread == nullptr) {
+    return;
+  }
+  if (thread->nesting++ == 0) {
+    thread->state.store((s_epoch.load() << 1) | 1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+}
+
+void frag_epoch_exit() {
+  epoch_thread_t* thread = get_thread();
+  if (thread == nullptr) {
+    return;
+  }
+  frag_assert(thread->nesting > 0, "exiting an epoch that was never entered");
+  if (--thread->nesting == 0) {
+    thread->state.store(thread->state.load() & ~(uint64_t)1);
+  }
+}
+
+void frag_free_deferred_ex(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
+  if (allocator == NULL || ptr == NULL) {
+    return;
+  }
+
+  epoch_thread_t* thread = get_thread();
+  if (thread == nullptr) {
+    // with nowhere to record it, the memory can never be known to be safe to free, so it has to leak
+    return;
+  }
+  epoch_batch_t* batch = thread->batch;
+  if (batch == nullptr) {
+    batch = (epoch_batch_t*)frag_alloc(frag_metadata_allocator(), sizeof(epoch_batch_t));
+    if (batch == nullptr) {
+      // there's no room to batch it up, so wait out the readers and free it now. outside of a read-side section
+      // synchronizing also frees everything else that's pending, which may make room for the next batch.
+      if (thread->nesting == 0) {
+        frag_epoch_synchronize();
+      }
+      else {
+        wait_for_readers(thread);
+      }
+      allocator_free(allocator, ptr, file, line, func);
+      return;
+    }
+    batch->count = 0;
+    thread->batch = batch;
+  }
+  epoch_retired_t* retired = batch->retired + batch->count;
+  retired->allocator = allocator;
+  retired->ptr = ptr;
+  retired->file = file;
+  retired->line = line;
+  retired->func = func;
+  if (++batch->count == EPOCH_BATCH_SIZE) {
+    seal_batch(thread);
+
+    // without a background reclaimer the writers have to do it, but they never wait on each other
+    if (!s_reclaimer_running.load()) {
+      collect(false);
+    }
+  }
+}
+
+void frag_epoch_collect() {
+  collect(false);
+}
+
+void frag_epoch_synchronize() {
+  epoch_thread_t* thread = get_thread();
+  if (thread != nullptr) {
+    frag_assert(thread->nesting == 0, "can't synchronize from inside an epoch");
+    seal_batch(thread);
+  }
+
+  // everything handed off by now was stamped with an epoch no later than this one, so it is all free to go two epochs
+  // on. batches sealed while waiting are left for later or this could wait forever on busy writers.
+  const uint64_t target = s_epoch.load() + 2;
+  while (s_epoch.load() < target) {
+    collect(true);
+    if (s_epoch.load() < target) {
+      std::this_thread::yield();
+    }
+  }
+
+  // the collection that reached the target may have been someone else's and still be running
+  collect(true);
+}
+
+void frag_epoch_reclaimer_start(unsigned int interval_msec) {
+  std::lock_guard<std::mutex> lock(s_reclaimer_mutex);
+  if (s_reclaimer_running.load()) {
+    return;
+  }
+  s_reclaimer_stop = false;
+  s_reclaimer = std::thread(&reclaimer_main, interval_msec);
+  s_reclaimer_running.store(true);
+}
+
+void frag_epoch_reclaimer_stop() {
+  {
+    std::lock_guard<std::mutex> lock(s_reclaimer_mutex);
+    if (!s_reclaimer_running.load()) {
+      return;
+    }
+    s_reclaimer_stop = true;
+  }
+  s_reclaimer_cond.notify_all();
+  s_reclaimer.join();
+  s_reclaimer_running.store(false);
+}
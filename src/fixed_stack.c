@@ -1,9 +1,7 @@
 #include "internal.h"
 
 typedef struct fixed_stack_allocator_impl_t {
-  char* beg;
-  char* end;
-  char* cur;
+  bump_stack_t stack;
 } fixed_stack_allocator_impl_t;
 
 typedef struct header_t {
@@ -11,25 +9,16 @@ typedef struct header_t {
   uint32_t size;
 } header_t;
 
-static size_t fixed_stack_get_size(const frag_allocator_t* allocator, void* ptr) {
-  const fixed_stack_allocator_impl_t* impl = (const fixed_stack_allocator_impl_t*)allocator->impl;
-
-  char* alloc_beg = (char*)ptr;
-  header_t* header = (header_t*)alloc_beg - 1;
-  char* alloc_end = alloc_beg + header->size;
-  frag_assert(impl->cur == alloc_end, "tried to free an invalid pointer");
-
-  char* new_cur = alloc_beg - header->pad;
-  frag_assert(impl->cur >= impl->beg, "malformed allocation header");
-  return (size_t)(alloc_end - new_cur);
+char* bump_stack_alloc_end(const bump_stack_t* stack, size_t size, size_t alignment) {
+  char* alloc_beg = (char*)align_up_with_offset_ptr(stack->cur, alignment, sizeof(header_t));
+  return alloc_beg + size;
 }
 
-static void* fixed_stack_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+void* bump_stack_alloc(bump_stack_t* stack, size_t size, size_t alignment, size_t* size_allocated) {
   frag_assert(size <= 0xfffffffful, "requested size exceeds maximum of 2^32.");
   frag_assert(is_pow_2(alignment), "alignment is not a power of 2");
-  fixed_stack_allocator_impl_t* impl = (fixed_stack_allocator_impl_t*)allocator->impl;
-  char* cur = impl->cur;
-  char* end = impl->end;
+  char* cur = stack->cur;
+  char* end = stack->end;
   char* alloc_beg = (char*)align_up_with_offset_ptr(cur, alignment, sizeof(header_t));
   char* alloc_end = alloc_beg + size;
   if (alloc_end > end) {
@@ -42,19 +31,100 @@ static void* fixed_stack_alloc(frag_allocator_t* allocator, size_t size, size_t
   header->pad = (uint32_t)(alloc_beg - cur);
   header->size = size;
 
-  impl->cur = alloc_end;
+  stack->cur = alloc_end;
 
   *size_allocated = (size_t)(alloc_end - cur);
   return alloc_beg;
 }
 
-static void fixed_stack_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
+void bump_stack_free(bump_stack_t* stack, void* ptr) {
   if (ptr == NULL) {
     return;
   }
-  fixed_stack_allocator_impl_t* impl = (fixed_stack_allocator_impl_t*)allocator->impl;
   header_t* header = (header_t*)ptr - 1;
-  impl->cur = (char*)ptr - header->pad;
+  stack->cur = (char*)ptr - header->pad;
+}
+
+size_t bump_stack_get_footprint(const void* ptr) {
+  const header_t* header = (const header_t*)ptr - 1;
+  return (size_t)header->pad + header->size;
+}
+
+bool bump_stack_is_top(const bump_stack_t* stack, const void* ptr) {
+  const header_t* header = (const header_t*)ptr - 1;
+  return (const char*)ptr + header->size == stack->cur;
+}
+
+bool bump_stack_resize(bump_stack_t* stack, void* ptr, size_t size, size_t* size_allocated_before, size_t* size_allocated) {
+  // only the allocation on top of the stack has room to move into
+  header_t* header = (header_t*)ptr - 1;
+  if (size > 0xfffffffful || !bump_stack_is_top(stack, ptr) || size > (size_t)(stack->end - (char*)ptr)) {
+    return false;
+  }
+
+  *size_allocated_before = (size_t)header->pad + header->size;
+  header->size = (uint32_t)size;
+  stack->cur = (char*)ptr + size;
+  *size_allocated = (size_t)header->pad + size;
+  return true;
+}
+
+size_t bump_stack_usable_size(const void* ptr) {
+  const header_t* header = (const header_t*)ptr - 1;
+  return header->size;
+}
+
+void bump_stack_query_layout(const bump_stack_t* stack, const char* end, frag_allocator_layout_t* layout) {
+  // everything above the top is one free block; holes left below it by out of order frees can't be reused until then
+  const size_t free_bytes = (size_t)(end - stack->cur);
+  layout->committed_bytes += (size_t)(end - stack->beg);
+  layout->free_bytes += free_bytes;
+  if (free_bytes > 0) {
+    layout->free_block_count++;
+  }
+  if (free_bytes > layout->largest_free_block) {
+    layout->largest_free_block = free_bytes;
+  }
+}
+
+size_t bump_stack_get_size(const bump_stack_t* stack, void* ptr) {
+  char* alloc_beg = (char*)ptr;
+  header_t* header = (header_t*)alloc_beg - 1;
+  char* alloc_end = alloc_beg + header->size;
+  frag_assert(stack->cur == alloc_end, "tried to free an invalid pointer");
+
+  char* new_cur = alloc_beg - header->pad;
+  frag_assert(new_cur >= stack->beg, "malformed allocation header");
+  return (size_t)(alloc_end - new_cur);
+}
+
+static size_t fixed_stack_get_size(const frag_allocator_t* allocator, void* ptr) {
+  const fixed_stack_allocator_impl_t* impl = (const fixed_stack_allocator_impl_t*)allocator->impl;
+  return bump_stack_get_size(&impl->stack, ptr);
+}
+
+static void* fixed_stack_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  fixed_stack_allocator_impl_t* impl = (fixed_stack_allocator_impl_t*)allocator->impl;
+  return bump_stack_alloc(&impl->stack, size, alignment, size_allocated);
+}
+
+static void fixed_stack_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
+  fixed_stack_allocator_impl_t* impl = (fixed_stack_allocator_impl_t*)allocator->impl;
+  bump_stack_free(&impl->stack, ptr);
+}
+
+static bool fixed_stack_resize(frag_allocator_t* allocator, void* ptr, size_t size, size_t* size_allocated_before, size_t* size_allocated) {
+  fixed_stack_allocator_impl_t* impl = (fixed_stack_allocator_impl_t*)allocator->impl;
+  return bump_stack_resize(&impl->stack, ptr, size, size_allocated_before, size_allocated);
+}
+
+static size_t fixed_stack_usable_size(const frag_allocator_t* allocator, void* ptr) {
+  return bump_stack_usable_size(ptr);
+}
+
+static void fixed_stack_query_layout(const frag_allocator_t* allocator, frag_allocator_layout_t* layout) {
+  const fixed_stack_allocator_impl_t* impl = (const fixed_stack_allocator_impl_t*)allocator->impl;
+  bump_stack_query_layout(&impl->stack, impl->stack.end, layout);
 }
 
 static void fixed_stack_shutdown(frag_allocator_t* allocator) {
@@ -68,13 +138,16 @@ frag_allocator_t* fixed_stack_create(frag_allocator_t* owner, const char* name,
   desc.free = &fixed_stack_free;
   desc.get_size = &fixed_stack_get_size;
   desc.shutdown = &fixed_stack_shutdown;
+  desc.resize = &fixed_stack_resize;
+  desc.usable_size = &fixed_stack_usable_size;
+  desc.query_layout = &fixed_stack_query_layout;
   desc.impl_size_bytes = sizeof(fixed_stack_allocator_impl_t);
   frag_allocator_t* allocator = allocator_create(owner, &desc);
 
   fixed_stack_allocator_impl_t* impl = (fixed_stack_allocator_impl_t*)allocator->impl;
-  impl->beg = buf;
-  impl->end = buf + size;
-  impl->cur = buf;
+  impl->stack.beg = buf;
+  impl->stack.end = buf + size;
+  impl->stack.cur = buf;
 
   return allocator;
 }
@@ -1,4 +1,6 @@
+#include <chrono>
 #include <mutex>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "frag.h"
@@ -29,14 +31,39 @@ static frag_config_t s_config;
 static char s_system_allocator_mem[SYSTEM_ALLOCATOR_MEM_SIZE_BYTES];
 static frag_allocator_t* s_system_allocator;
 
+// the address space set aside for frag's own bookkeeping (only what is used gets committed)
+#define METADATA_RESERVE_BYTES ((size_t)1 << 30)
+#define METADATA_ALLOCATOR_MEM_SIZE_BYTES (sizeof(frag_allocator_t) + sizeof(std::mutex) + sizeof("frag metadata"))
+static char s_metadata_allocator_mem[METADATA_ALLOCATOR_MEM_SIZE_BYTES];
+static frag_allocator_t* s_metadata_allocator;
+
+// every live allocator, so tools like tracing can visit them all
+static std::mutex s_registry_mutex;
+static frag_allocator_t* s_registry_head;
+
+// the most memory an incremental trim will ask an allocator to release in a single step
+#define TRIM_INCREMENTAL_STEP_BYTES (256 * 1024)
+
 static void default_assert(const char* file, int line, const char* func, const char* expression, const char* message) {
   fprintf(stderr, "ASSERT FAILURE: %s\n%s\nfile: %s\nline: %d\nfunc: %s\n", expression, message, file, line, func);
   exit(EXIT_FAILURE);
 }
 
+static void query_stats(const frag_allocator_t* allocator, frag_allocator_stats_t* stats) {
+  if (allocator->query_stats != NULL) {
+    allocator->query_stats(allocator, stats);
+  }
+  else {
+    *stats = allocator->stats;
+  }
+}
+
 static void default_report_leak(const frag_allocator_t* allocator, const frag_leak_report_t* report) {
+  frag_allocator_stats_t stats;
+  query_stats(allocator, &stats);
+
   char message[128];
-  snprintf(message, 128, "leak detected. allocator=%s, count=%zu, size=%zu", allocator->name, allocator->stats.count, allocator->stats.bytes);
+  snprintf(message, 128, "leak detected. allocator=%s, count=%zu, size=%zu", allocator->name, stats.count, stats.bytes);
   message[127] = 0;
 
   fprintf(stderr, "%s\n", message);
@@ -51,6 +78,41 @@ static void default_report_out_of_memory(const frag_allocator_t* allocator, size
   frag_assert(false, "out of memory");
 }
 
+static const char* guard_fault_kind_name(frag_guard_fault_kind_t kind) {
+  switch (kind) {
+  case FRAG_GUARD_FAULT_OVERFLOW:
+    return "overflow";
+  case FRAG_GUARD_FAULT_UNDERFLOW:
+    return "underflow";
+  case FRAG_GUARD_FAULT_USE_AFTER_FREE:
+    return "use after free";
+  case FRAG_GUARD_FAULT_DOUBLE_FREE:
+    return "double free";
+  case FRAG_GUARD_FAULT_INVALID_FREE:
+    return "invalid free";
+  default:
+    return "unknown";
+  }
+}
+
+static void default_report_guard_fault(const frag_allocator_t* allocator, const frag_guard_fault_t* fault) {
+  fprintf(stderr, "guard fault detected. allocator=%s, kind=%s, address=%016lx\n", allocator->name, guard_fault_kind_name(fault->kind), (uintptr_t)fault->address);
+  if (fault->ptr != NULL) {
+    fprintf(stderr, "ptr=%016lx size=%zu\n", (uintptr_t)fault->ptr, fault->size);
+  }
+  if (fault->alloc_file != NULL) {
+    fprintf(stderr, "allocated: file='%s' line=%d func=%s\n", fault->alloc_file, fault->alloc_line, fault->alloc_func);
+  }
+  if (fault->free_file != NULL) {
+    fprintf(stderr, "freed: file='%s' line=%d func=%s\n", fault->free_file, fault->free_line, fault->free_func);
+  }
+
+  // bad accesses carry on to crash in the signal handler but a bad free would otherwise go unnoticed
+  if (fault->kind == FRAG_GUARD_FAULT_DOUBLE_FREE || fault->kind == FRAG_GUARD_FAULT_INVALID_FREE) {
+    frag_assert(false, "invalid free");
+  }
+}
+
 void frag_assert_ex(const char* file, int line, const char* func, const char* expression, const char* message) {
   s_config.assert_handler(file, line, func, expression, message);
 }
@@ -69,36 +131,31 @@ void* align_up_with_offset_ptr(void* cur, size_t alignment, size_t offset) {
   return cur;
 }
 
-static void report_alloc(frag_allocator_t* allocator,
-                         void* ptr,
-                         size_t size_requested,
-                         size_t size_allocated,
-                         size_t alignment,
-                         const char* file,
-                         int line,
-                         const char* func) {
-  ++allocator->stats.count;
-  if (allocator->stats.count > allocator->stats.count_peak) {
-    allocator->stats.count_peak = allocator->stats.count;
-  }
-
-  allocator->stats.bytes += size_allocated;
-  if (allocator->stats.bytes > allocator->stats.bytes_peak) {
-    allocator->stats.bytes_peak = allocator->stats.bytes;
-  }
-
-  if (s_config.enable_detailed_leak_reports) {
+void allocator_track_alloc(frag_allocator_t* allocator, void* ptr, size_t size, const char* file, int line, const char* func) {
+  // the metadata allocator holds the tracking tables so it can't track itself
+  if (s_config.enable_detailed_leak_reports && allocator != s_metadata_allocator) {
     frag_allocator_debug_t* debug = &allocator->debug;
     if (debug->count >= debug->capacity) {
-      const uint32_t new_capacity = debug->capacity + 256;
+      const unsigned int new_capacity = debug->capacity + 256;
+      const size_t new_size = new_capacity * sizeof(frag_debug_alloc_info_t);
+      size_t size_allocated_before;
       size_t size_allocated;
-      frag_debug_alloc_info_t* allocs = (frag_debug_alloc_info_t*)s_system_allocator->alloc(s_system_allocator, new_capacity * sizeof(frag_debug_alloc_info_t), s_config.default_alignment, __FILE__, __LINE__, __func__, &size_allocated);
-      memmove(allocs, debug->allocs, debug->count * sizeof(frag_debug_alloc_info_t));
-      debug->allocs = allocs;
+      if (debug->allocs == NULL || !allocator_resize(s_metadata_allocator, debug->allocs, new_size, &size_allocated_before, &size_allocated)) {
+        frag_debug_alloc_info_t* allocs = (frag_debug_alloc_info_t*)allocator_alloc(s_metadata_allocator, new_size, 0, __FILE__, __LINE__, __func__, &size_allocated);
+        if (allocs == NULL) {
+          return;
+        }
+        if (debug->allocs != NULL) {
+          memmove(allocs, debug->allocs, debug->count * sizeof(frag_debug_alloc_info_t));
+          allocator_free(s_metadata_allocator, debug->allocs, __FILE__, __LINE__, __func__);
+        }
+        debug->allocs = allocs;
+      }
       debug->capacity = new_capacity;
     }
     frag_debug_alloc_info_t* alloc = debug->allocs + debug->count;
     alloc->ptr = ptr;
+    alloc->size = size;
     alloc->file = file;
     alloc->line = line;
     alloc->func = func;
@@ -106,15 +163,43 @@ static void report_alloc(frag_allocator_t* allocator,
   }
 }
 
+static void report_alloc(frag_allocator_t* allocator,
+                         void* ptr,
+                         size_t size_requested,
+                         size_t size_allocated,
+                         size_t alignment,
+                         const char* file,
+                         int line,
+                         const char* func) {
+  // allocators that can query their own stats keep track of them themselves
+  if (allocator->query_stats == NULL) {
+    ++allocator->stats.count;
+    if (allocator->stats.count > allocator->stats.count_peak) {
+      allocator->stats.count_peak = allocator->stats.count;
+    }
+
+    allocator->stats.bytes += size_allocated;
+    if (allocator->stats.bytes > allocator->stats.bytes_peak) {
+      allocator->stats.bytes_peak = allocator->stats.bytes;
+    }
+  }
+  trace_alloc(allocator, ptr, size_allocated);
+
+  allocator_track_alloc(allocator, ptr, size_allocated, file, line, func);
+}
+
 static void report_free(frag_allocator_t* allocator, void* ptr, size_t size, const char* file, int line, const char* func) {
   // assert(allocator->stats.count > 0);
   // assert(allocator->stats.bytes >= size);
-  --allocator->stats.count;
-  allocator->stats.bytes -= size;
+  if (allocator->query_stats == NULL) {
+    --allocator->stats.count;
+    allocator->stats.bytes -= size;
+  }
+  trace_free(allocator, ptr, size);
 
   if (s_config.enable_detailed_leak_reports) {
     frag_allocator_debug_t* debug = &allocator->debug;
-    for (uint32_t iter = debug->count; iter > 0; --iter) {
+    for (unsigned int iter = debug->count; iter > 0; --iter) {
       uint32_t index = iter - 1;
       frag_debug_alloc_info_t* alloc = debug->allocs + index;
       if (alloc->ptr == ptr) {
@@ -130,13 +215,17 @@ static void report_free(frag_allocator_t* allocator, void* ptr, size_t size, con
   }
 }
 
-static void report_leak(const frag_allocator_t* allocator) {
+void allocator_report_leak(const frag_allocator_t* allocator) {
   frag_leak_report_t report = {};
   report.allocs = allocator->debug.allocs;
   report.alloc_count = allocator->debug.count;
   s_config.report_leak(allocator, &report);
 }
 
+void allocator_report_guard_fault(const frag_allocator_t* allocator, const frag_guard_fault_t* fault) {
+  s_config.report_guard_fault(allocator, fault);
+}
+
 static void report_out_of_memory(const frag_allocator_t* allocator,
                                  size_t size,
                                  size_t alignment,
@@ -190,46 +279,209 @@ frag_allocator_t* allocator_init(void* buffer, size_t buffer_size_bytes, frag_al
   allocator->free = desc->free;
   allocator->get_size = desc->get_size;
   allocator->shutdown = desc->shutdown;
+  allocator->trim = desc->trim;
+  allocator->alloc_zero = desc->alloc_zero;
+  allocator->query_stats = desc->query_stats;
+  allocator->resize = desc->resize;
+  allocator->usable_size = desc->usable_size;
+  allocator->free_sized = desc->free_sized;
+  allocator->query_layout = desc->query_layout;
   allocator->debug.allocs = NULL;
   allocator->debug.count = 0;
   allocator->debug.capacity = 0;
+  allocator->alloc_refused = false;
+  allocator->delegate = desc->delegate;
+  memset(&allocator->budget, 0, sizeof(allocator->budget));
+
+  std::lock_guard<std::mutex> registry_lock(s_registry_mutex);
+  allocator->registry_prev = NULL;
+  allocator->registry_next = s_registry_head;
+  if (s_registry_head != NULL) {
+    s_registry_head->registry_prev = allocator;
+  }
+  s_registry_head = allocator;
 
   return allocator;
 }
 
-void allocator_shutdown(frag_allocator_t* allocator) {
-  if (allocator->stats.count != 0) {
-    report_leak(allocator);
+static void registry_remove(frag_allocator_t* allocator) {
+  std::lock_guard<std::mutex> registry_lock(s_registry_mutex);
+  if (allocator->registry_prev == NULL && s_registry_head != allocator) {
+    // already removed (e.g. a previous shutdown attempt reported a leak)
+    return;
   }
-  if (s_config.enable_detailed_leak_reports) {
-    if (allocator->debug.count > 0) {
-      s_system_allocator->free(s_system_allocator, allocator->debug.allocs, __FILE__, __LINE__, __func__);
+  if (allocator->registry_prev != NULL) {
+    allocator->registry_prev->registry_next = allocator->registry_next;
+  }
+  else {
+    s_registry_head = allocator->registry_next;
+  }
+  if (allocator->registry_next != NULL) {
+    allocator->registry_next->registry_prev = allocator->registry_prev;
+  }
+  allocator->registry_prev = NULL;
+  allocator->registry_next = NULL;
+}
+
+void registry_for_each(void (*func)(frag_allocator_t* allocator, void* user_data), void* user_data) {
+  std::lock_guard<std::mutex> registry_lock(s_registry_mutex);
+  for (frag_allocator_t* allocator = s_registry_head; allocator != NULL; allocator = allocator->registry_next) {
+    func(allocator, user_data);
+  }
+}
+
+typedef void* (*alloc_func_t)(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated);
+
+static size_t allocator_bytes(const frag_allocator_t* allocator) {
+  if (allocator->query_stats == NULL) {
+    return allocator->stats.bytes;
+  }
+  frag_allocator_stats_t stats;
+  allocator->query_stats(allocator, &stats);
+  return stats.bytes;
+}
+
+static bool allocator_is_under(const frag_allocator_t* allocator, const frag_allocator_t* ancestor) {
+  for (; allocator != NULL; allocator = allocator->owner) {
+    if (allocator == ancestor) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Budgets cover an allocator and everything created under it. Returns the next allocator up from `covering` whose
+// budget covers `allocator`, or NULL. An allocator's usage stops counting at the first owner its delegate is also
+// under, since the delegate's own usage is already counted from there on up.
+static frag_allocator_t* budget_parent(const frag_allocator_t* allocator, const frag_allocator_t* covering) {
+  frag_allocator_t* owner = covering->owner;
+  if (owner == NULL || (allocator->delegate != NULL && allocator_is_under(allocator->delegate, owner))) {
+    return NULL;
+  }
+  return owner;
+}
+
+// Checks `size` more bytes against the hard limits of every budget covering the allocator.
+static bool budget_fits(const frag_allocator_t* allocator, size_t size) {
+  for (const frag_allocator_t* covering = allocator; covering != NULL; covering = budget_parent(allocator, covering)) {
+    const size_t hard_limit = __atomic_load_n(&covering->budget.hard_limit, __ATOMIC_RELAXED);
+    if (hard_limit != 0 && __atomic_load_n(&covering->budget.bytes, __ATOMIC_RELAXED) + size > hard_limit) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void budget_add(frag_allocator_t* allocator, size_t delta) {
+  for (frag_allocator_t* covering = allocator; covering != NULL; covering = budget_parent(allocator, covering)) {
+    __atomic_add_fetch(&covering->budget.bytes, delta, __ATOMIC_RELAXED);
+  }
+}
+
+// Adds any change in the allocator's own usage to every budget covering it. The allocator must be locked.
+static void budget_sync(frag_allocator_t* allocator) {
+  const size_t bytes = allocator_bytes(allocator);
+  if (bytes != allocator->budget.synced_bytes) {
+    // a drop wraps around and is subtracted
+    budget_add(allocator, bytes - allocator->budget.synced_bytes);
+    allocator->budget.synced_bytes = bytes;
+  }
+}
+
+// Rearms the pressure handlers of budgets covering the allocator that are back under their soft limit. If `notify` is
+// set, it also calls the handlers of the ones that have just crossed it, so it must be called without the allocator
+// locked so that they can free memory back to it.
+static void budget_update(frag_allocator_t* allocator, bool notify) {
+  for (frag_allocator_t* covering = allocator; covering != NULL; covering = budget_parent(allocator, covering)) {
+    frag_allocator_budget_t* budget = &covering->budget;
+    const size_t soft_limit = __atomic_load_n(&budget->soft_limit, __ATOMIC_RELAXED);
+    if (soft_limit == 0) {
+      continue;
+    }
+
+    // only signal pressure when crossing the soft limit rather than on every allocation above it
+    const size_t bytes = __atomic_load_n(&budget->bytes, __ATOMIC_RELAXED);
+    if (bytes < soft_limit) {
+      if (__atomic_load_n(&budget->over_soft_limit, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&budget->over_soft_limit, false, __ATOMIC_RELAXED);
+      }
+    }
+    else if (notify && !__atomic_exchange_n(&budget->over_soft_limit, true, __ATOMIC_ACQ_REL)) {
+      const frag_pressure_handler_t handler = __atomic_load_n(&budget->pressure_handler, __ATOMIC_ACQUIRE);
+      if (handler != NULL) {
+        handler(covering, bytes, soft_limit, __atomic_load_n(&budget->pressure_user_data, __ATOMIC_ACQUIRE));
+      }
     }
   }
+}
+
+void allocator_shutdown(frag_allocator_t* allocator) {
+  registry_remove(allocator);
+  // whatever it still holds stops counting against the budgets it was under
+  budget_add(allocator, 0 - allocator->budget.synced_bytes);
+  trace_allocator_shutdown(allocator);
+  if (allocator->stats.count != 0) {
+    allocator_report_leak(allocator);
+  }
+  // the tracking outlives the implementation's shutdown since some allocators report their own leaks from there
   allocator->shutdown(allocator);
+  if (allocator->debug.allocs != NULL) {
+    allocator_free(s_metadata_allocator, allocator->debug.allocs, __FILE__, __LINE__, __func__);
+    allocator->debug.allocs = NULL;
+    allocator->debug.count = 0;
+    allocator->debug.capacity = 0;
+  }
   std::mutex* mutex = (std::mutex*)allocator->mutex;
   if (mutex != NULL) {
     mutex->~mutex();
   }
 }
 
-void* allocator_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+static void* allocator_alloc_with(frag_allocator_t* allocator, alloc_func_t alloc_func, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
   if (alignment == 0) {
     alignment = s_config.default_alignment;
   }
 
-  // protect access to this allocator if necessary
-  optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+  void* ptr = NULL;
+  {
+    // protect access to this allocator if necessary
+    optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+    if (budget_fits(allocator, size)) {
+      ptr = alloc_func(allocator, size, alignment, file, line, func, size_allocated);
+    }
+    if (ptr != NULL) {
+      report_alloc(allocator, ptr, size, *size_allocated, alignment, file, line, func);
+      budget_sync(allocator);
+    }
+    else {
+      *size_allocated = 0;
+      if (!allocator->alloc_refused) {
+        report_out_of_memory(allocator, size, alignment, file, line, func);
+      }
+      allocator->alloc_refused = false;
+    }
+  }
 
-  void* ptr = allocator->alloc(allocator, size, alignment, file, line, func, size_allocated);
   if (ptr != NULL) {
-    report_alloc(allocator, ptr, size, *size_allocated, alignment, file, line, func);
+    budget_update(allocator, true);
   }
-  else {
-    *size_allocated = 0;
-    report_out_of_memory(allocator, size, alignment, file, line, func);
+  return ptr;
+}
+
+void* allocator_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  return allocator_alloc_with(allocator, allocator->alloc, size, alignment, file, line, func, size_allocated);
+}
+
+void* allocator_alloc_zero(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  if (allocator->alloc_zero != NULL) {
+    return allocator_alloc_with(allocator, allocator->alloc_zero, size, alignment, file, line, func, size_allocated);
   }
 
+  void* ptr = allocator_alloc(allocator, size, alignment, file, line, func, size_allocated);
+  if (ptr != NULL) {
+    memset(ptr, 0, size);
+  }
   return ptr;
 }
 
@@ -244,6 +496,33 @@ void allocator_free(frag_allocator_t* allocator, void* ptr, const char* file, in
   size_t size_allocated = allocator->get_size(allocator, ptr);
   allocator->free(allocator, ptr, file, line, func);
   report_free(allocator, ptr, size_allocated, file, line, func);
+  budget_sync(allocator);
+  budget_update(allocator, false);
+}
+
+size_t allocator_free_sized(frag_allocator_t* allocator, void* ptr, size_t size, size_t alignment, const char* file, int line, const char* func) {
+  if (ptr == NULL) {
+    return 0;
+  }
+  if (alignment == 0) {
+    alignment = s_config.default_alignment;
+  }
+
+  // protect access to this allocator if necessary
+  optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+  size_t size_allocated;
+  if (allocator->free_sized != NULL) {
+    size_allocated = allocator->free_sized(allocator, ptr, size, alignment, file, line, func);
+  }
+  else {
+    size_allocated = allocator->get_size(allocator, ptr);
+    allocator->free(allocator, ptr, file, line, func);
+  }
+  report_free(allocator, ptr, size_allocated, file, line, func);
+  budget_sync(allocator);
+  budget_update(allocator, false);
+  return size_allocated;
 }
 
 size_t allocator_get_size(const frag_allocator_t* allocator, void* ptr) {
@@ -253,6 +532,117 @@ size_t allocator_get_size(const frag_allocator_t* allocator, void* ptr) {
   return allocator->get_size(allocator, ptr);
 }
 
+bool allocator_resize(frag_allocator_t* allocator, void* ptr, size_t size, size_t* size_allocated_before, size_t* size_allocated) {
+  if (allocator->resize == NULL) {
+    return false;
+  }
+
+  {
+    // protect access to this allocator if necessary
+    optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+    // growing in place still counts against the budget
+    const size_t usable = allocator->usable_size != NULL ? allocator->usable_size(allocator, ptr) : allocator->get_size(allocator, ptr);
+    if (size > usable && !budget_fits(allocator, size - usable)) {
+      return false;
+    }
+    if (!allocator->resize(allocator, ptr, size, size_allocated_before, size_allocated)) {
+      return false;
+    }
+
+    if (allocator->query_stats == NULL) {
+      allocator->stats.bytes = allocator->stats.bytes - *size_allocated_before + *size_allocated;
+      if (allocator->stats.bytes > allocator->stats.bytes_peak) {
+        allocator->stats.bytes_peak = allocator->stats.bytes;
+      }
+    }
+    trace_free(allocator, ptr, *size_allocated_before);
+    trace_alloc(allocator, ptr, *size_allocated);
+    if (s_config.enable_detailed_leak_reports) {
+      frag_allocator_debug_t* debug = &allocator->debug;
+      for (unsigned int iter = debug->count; iter > 0; --iter) {
+        if (debug->allocs[iter - 1].ptr == ptr) {
+          debug->allocs[iter - 1].size = *size_allocated;
+          break;
+        }
+      }
+    }
+
+    budget_sync(allocator);
+  }
+
+  // growing can cross the soft limit and shrinking can drop back under it, just like allocating and freeing
+  budget_update(allocator, *size_allocated > *size_allocated_before);
+  return true;
+}
+
+size_t allocator_usable_size(const frag_allocator_t* allocator, void* ptr) {
+  // protect access to this allocator if necessary
+  optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+  if (allocator->usable_size != NULL) {
+    return allocator->usable_size(allocator, ptr);
+  }
+  return allocator->get_size(allocator, ptr);
+}
+
+size_t allocator_trim(frag_allocator_t* allocator, size_t keep_bytes, size_t max_release_bytes) {
+  if (allocator->trim == NULL) {
+    return 0;
+  }
+
+  // protect access to this allocator if necessary
+  optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+  return allocator->trim(allocator, keep_bytes, max_release_bytes);
+}
+
+bool allocator_fits_budget(const frag_allocator_t* allocator, size_t size) {
+  return budget_fits(allocator, size);
+}
+
+void allocator_unlock(frag_allocator_t* allocator) {
+  if (allocator->mutex != NULL) {
+    ((std::mutex*)allocator->mutex)->unlock();
+  }
+}
+
+void allocator_lock(frag_allocator_t* allocator) {
+  if (allocator->mutex != NULL) {
+    ((std::mutex*)allocator->mutex)->lock();
+  }
+}
+
+void allocator_release_range(frag_allocator_t* allocator, const void* beg, const void* end, size_t bytes, size_t count) {
+  // move the tracked allocations inside the range to the back so they can be reported and dropped in one go
+  frag_allocator_debug_t* debug = &allocator->debug;
+  unsigned int released_index = debug->count;
+  if (s_config.enable_detailed_leak_reports) {
+    for (unsigned int iter = debug->count; iter > 0; --iter) {
+      const unsigned int index = iter - 1;
+      frag_debug_alloc_info_t alloc = debug->allocs[index];
+      if (alloc.ptr >= beg && alloc.ptr < end) {
+        --released_index;
+        debug->allocs[index] = debug->allocs[released_index];
+        debug->allocs[released_index] = alloc;
+      }
+    }
+  }
+
+  if (count > 0) {
+    frag_leak_report_t report = {};
+    report.allocs = debug->allocs + released_index;
+    report.alloc_count = debug->count - released_index;
+    s_config.report_leak(allocator, &report);
+  }
+
+  allocator->stats.count -= count;
+  allocator->stats.bytes -= bytes;
+  debug->count = released_index;
+  budget_sync(allocator);
+  budget_update(allocator, false);
+}
+
 frag_allocator_t* allocator_create(frag_allocator_t* owner, const frag_allocator_desc_t* desc) {
   const size_t buffer_size_bytes = calc_allocator_size(desc);
   size_t size_allocated;
@@ -265,6 +655,7 @@ void frag_config_init(frag_config_t* config) {
     config->assert_handler = &default_assert;
     config->report_leak = &default_report_leak;
     config->report_out_of_memory = &default_report_out_of_memory;
+    config->report_guard_fault = &default_report_guard_fault;
     config->default_alignment = 16;
     config->enable_detailed_leak_reports = false;
   }
@@ -280,12 +671,18 @@ void frag_lib_init(const frag_config_t* config) {
 
   frag_assert(s_system_allocator == NULL, "frag_init is already initialized");
 
+  s_metadata_allocator = metadata_create(s_metadata_allocator_mem, METADATA_ALLOCATOR_MEM_SIZE_BYTES, "frag metadata", METADATA_RESERVE_BYTES);
   s_system_allocator = system_create(s_system_allocator_mem, SYSTEM_ALLOCATOR_MEM_SIZE_BYTES, "system", true);
 }
 
 void frag_lib_shutdown() {
+  epoch_shutdown();
+  coroutine_shutdown();
+  trace_shutdown();
   allocator_shutdown(s_system_allocator);
   s_system_allocator = NULL;
+  allocator_shutdown(s_metadata_allocator);
+  s_metadata_allocator = NULL;
 }
 
 void* frag_alloc_ex(frag_allocator_t* allocator,
@@ -311,11 +708,7 @@ void* frag_alloc_zero_ex(frag_allocator_t* allocator,
     return NULL;
   }
   size_t size_allocated;
-  void* ptr = allocator_alloc(allocator, size, alignment, file, line, func, &size_allocated);
-  if (ptr != NULL) {
-    memset(ptr, 0, size);
-  }
-  return ptr;
+  return allocator_alloc_zero(allocator, size, alignment, file, line, func, &size_allocated);
 }
 
 void* frag_realloc_ex(frag_allocator_t* allocator, void* ptr, size_t size, size_t alignment, const char* file, int line, const char* func) {
@@ -325,10 +718,20 @@ void* frag_realloc_ex(frag_allocator_t* allocator, void* ptr, size_t size, size_
 
   void* ptr_new = NULL;
   if (size > 0) {
+    // growing or shrinking in place saves the copy, as long as the existing memory is aligned well enough
+    size_t size_allocated_before;
     size_t size_allocated;
+    const size_t alignment_required = alignment != 0 ? alignment : s_config.default_alignment;
+    if (ptr != NULL && ((uintptr_t)ptr & (alignment_required - 1)) == 0 && allocator_resize(allocator, ptr, size, &size_allocated_before, &size_allocated)) {
+      return ptr;
+    }
+
     ptr_new = allocator_alloc(allocator, size, alignment, file, line, func, &size_allocated);
+    if (ptr_new == NULL) {
+      return NULL;
+    }
     if (ptr != NULL) {
-      const size_t size_old = allocator_get_size(allocator, ptr);
+      const size_t size_old = allocator_usable_size(allocator, ptr);
       const size_t size_to_copy = size < size_old ? size : size_old;
       memmove(ptr_new, ptr, size_to_copy);
     }
@@ -340,6 +743,22 @@ void* frag_realloc_ex(frag_allocator_t* allocator, void* ptr, size_t size, size_
   return ptr_new;
 }
 
+bool frag_resize_ex(frag_allocator_t* allocator, void* ptr, size_t size, const char* file, int line, const char* func) {
+  if (allocator == NULL || ptr == NULL) {
+    return false;
+  }
+  size_t size_allocated_before;
+  size_t size_allocated;
+  return allocator_resize(allocator, ptr, size, &size_allocated_before, &size_allocated);
+}
+
+size_t frag_usable_size(frag_allocator_t* allocator, void* ptr) {
+  if (allocator == NULL || ptr == NULL) {
+    return 0;
+  }
+  return allocator_usable_size(allocator, ptr);
+}
+
 void frag_free_ex(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
   if (allocator == NULL) {
     return;
@@ -347,10 +766,28 @@ void frag_free_ex(frag_allocator_t* allocator, void* ptr, const char* file, int
   allocator_free(allocator, ptr, file, line, func);
 }
 
+void frag_free_sized_ex(frag_allocator_t* allocator, void* ptr, size_t size, size_t alignment, const char* file, int line, const char* func) {
+  if (allocator == NULL) {
+    return;
+  }
+  allocator_free_sized(allocator, ptr, size, alignment, file, line, func);
+}
+
 frag_allocator_t* frag_system_allocator() {
   return s_system_allocator;
 }
 
+frag_allocator_t* frag_metadata_allocator() {
+  return s_metadata_allocator;
+}
+
+frag_allocator_t* frag_allocator_create(frag_allocator_t* owner, const frag_allocator_desc_t* desc) {
+  if (owner == NULL || desc == NULL) {
+    return NULL;
+  }
+  return allocator_create(owner, desc);
+}
+
 void frag_allocator_destroy(frag_allocator_t* owner, frag_allocator_t* allocator) {
   if (owner == NULL || allocator == NULL) {
     return;
@@ -359,6 +796,52 @@ void frag_allocator_destroy(frag_allocator_t* owner, frag_allocator_t* allocator
   allocator_free(owner, allocator, __FILE__, __LINE__, __func__);
 }
 
+void frag_allocator_set_budget(frag_allocator_t* allocator, size_t soft_limit, size_t hard_limit) {
+  frag_assert(allocator != NULL, "allocator is null");
+
+  // protect access to this allocator if necessary
+  optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+  frag_allocator_budget_t* budget = &allocator->budget;
+  __atomic_store_n(&budget->soft_limit, soft_limit, __ATOMIC_RELAXED);
+  __atomic_store_n(&budget->hard_limit, hard_limit, __ATOMIC_RELAXED);
+  __atomic_store_n(&budget->over_soft_limit, soft_limit != 0 && __atomic_load_n(&budget->bytes, __ATOMIC_RELAXED) >= soft_limit, __ATOMIC_RELAXED);
+}
+
+void frag_allocator_set_pressure_handler(frag_allocator_t* allocator, frag_pressure_handler_t handler, void* user_data) {
+  frag_assert(allocator != NULL, "allocator is null");
+
+  // protect access to this allocator if necessary
+  optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+  __atomic_store_n(&allocator->budget.pressure_user_data, user_data, __ATOMIC_RELEASE);
+  __atomic_store_n(&allocator->budget.pressure_handler, handler, __ATOMIC_RELEASE);
+}
+
+size_t frag_allocator_trim(frag_allocator_t* allocator, size_t keep_bytes) {
+  if (allocator == NULL) {
+    return 0;
+  }
+  return allocator_trim(allocator, keep_bytes, SIZE_MAX);
+}
+
+size_t frag_allocator_trim_incremental(frag_allocator_t* allocator, size_t keep_bytes, unsigned int time_budget_usec) {
+  if (allocator == NULL) {
+    return 0;
+  }
+
+  // release in small steps, re-acquiring the lock each time, until there is nothing left or we run out of time
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(time_budget_usec);
+  size_t released_total = 0;
+  size_t released;
+  do {
+    released = allocator_trim(allocator, keep_bytes, TRIM_INCREMENTAL_STEP_BYTES);
+    released_total += released;
+  } while (released > 0 && std::chrono::steady_clock::now() < deadline);
+
+  return released_total;
+}
+
 void frag_allocator_stats(const frag_allocator_t* allocator, frag_allocator_stats_t* stats) {
   frag_assert(allocator != NULL, "allocator is null");
   frag_assert(stats != NULL, "stats is null");
@@ -366,17 +849,160 @@ void frag_allocator_stats(const frag_allocator_t* allocator, frag_allocator_stat
   // protect access to this allocator if necessary
   optional_lock_guard_t lock((std::mutex*)allocator->mutex);
 
-  *stats = allocator->stats;
+  query_stats(allocator, stats);
+}
+
+bool frag_allocator_fragmentation(const frag_allocator_t* allocator, frag_allocator_layout_t* layout) {
+  if (!frag_assert(allocator != NULL, "allocator is null") || !frag_assert(layout != NULL, "layout is null")) {
+    return false;
+  }
+  memset(layout, 0, sizeof(*layout));
+  if (allocator->query_layout == NULL) {
+    return false;
+  }
+
+  {
+    // protect access to this allocator if necessary
+    optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+    allocator->query_layout(allocator, layout);
+  }
+  if (layout->free_bytes > 0) {
+    layout->fragmentation = 1.0 - (double)layout->largest_free_block / (double)layout->free_bytes;
+  }
+  return true;
 }
 
 frag_allocator_t* frag_fixed_stack_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, char* buf, size_t buf_size) {
   return fixed_stack_create(owner, name, needs_lock, buf, buf_size);
 }
 
+frag_allocator_t* frag_frame_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, char* buf, size_t buf_size, unsigned int frame_count) {
+  return frame_create(owner, name, needs_lock, buf, buf_size, frame_count);
+}
+
+void frag_frame_allocator_advance(frag_allocator_t* allocator) {
+  frag_assert(allocator != NULL, "allocator is null");
+
+  // protect access to this allocator if necessary
+  optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+  frame_advance(allocator);
+}
+
+void frag_frame_allocator_stats(const frag_allocator_t* allocator, unsigned int frames_ago, frag_allocator_stats_t* stats) {
+  frag_assert(allocator != NULL, "allocator is null");
+  frag_assert(stats != NULL, "stats is null");
+
+  // protect access to this allocator if necessary
+  optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+  frame_stats(allocator, frames_ago, stats);
+}
+
+frag_allocator_t* frag_vm_stack_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, size_t reserve_size, size_t decommit_slack) {
+  return vm_stack_create(owner, name, needs_lock, reserve_size, decommit_slack);
+}
+
+frag_allocator_t* frag_buddy_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, void* base, size_t size, size_t min_block_size) {
+  return buddy_create(owner, name, needs_lock, base, size, min_block_size);
+}
+
+frag_allocator_t* frag_shm_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, const char* shm_name, size_t size) {
+  return shm_create(owner, name, needs_lock, shm_name, size);
+}
+
+frag_allocator_t* frag_shm_allocator_attach(frag_allocator_t* owner, const char* name, bool needs_lock, const char* shm_name) {
+  frag_allocator_t* allocator = shm_attach(owner, name, needs_lock, shm_name);
+  if (allocator != NULL) {
+    // what's already allocated in there counts against the budgets it's attached under
+    optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+    budget_sync(allocator);
+  }
+  return allocator;
+}
+
+size_t frag_shm_allocator_ptr_to_offset(const frag_allocator_t* allocator, const void* ptr) {
+  return shm_ptr_to_offset(allocator, ptr);
+}
+
+void* frag_shm_allocator_offset_to_ptr(const frag_allocator_t* allocator, size_t offset) {
+  return shm_offset_to_ptr(allocator, offset);
+}
+
+frag_allocator_t* frag_persistent_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, const char* path, size_t size, void* base_address) {
+  frag_allocator_t* allocator = persistent_create(owner, name, needs_lock, path, size, base_address);
+  if (allocator != NULL) {
+    // what the file already holds counts against the budgets it's created under
+    optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+    budget_sync(allocator);
+  }
+  return allocator;
+}
+
+void* frag_persistent_allocator_root(const frag_allocator_t* allocator) {
+  frag_assert(allocator != NULL, "allocator is null");
+
+  // protect access to this allocator if necessary
+  optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+  return persistent_root(allocator);
+}
+
+void frag_persistent_allocator_set_root(frag_allocator_t* allocator, void* root) {
+  frag_assert(allocator != NULL, "allocator is null");
+
+  // protect access to this allocator if necessary
+  optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+  persistent_set_root(allocator, root);
+}
+
+ptrdiff_t frag_persistent_allocator_relocation_delta(const frag_allocator_t* allocator) {
+  frag_assert(allocator != NULL, "allocator is null");
+
+  // protect access to this allocator if necessary
+  optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+  return persistent_relocation_delta(allocator);
+}
+
+void frag_persistent_allocator_relocate(frag_allocator_t* allocator, frag_persistent_relocate_func_t func, void* user_data) {
+  frag_assert(allocator != NULL, "allocator is null");
+
+  // not locked so the callback can allocate; nothing else may be using the arena yet anyway
+  persistent_relocate(allocator, func, user_data);
+}
+
+bool frag_persistent_allocator_flush(frag_allocator_t* allocator) {
+  frag_assert(allocator != NULL, "allocator is null");
+
+  // protect access to this allocator if necessary
+  optional_lock_guard_t lock((std::mutex*)allocator->mutex);
+
+  return persistent_flush(allocator);
+}
+
+frag_allocator_t* frag_guarded_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, frag_allocator_t* delegate, unsigned int slot_count, unsigned int sample_rate) {
+  return guarded_create(owner, name, needs_lock, delegate, slot_count, sample_rate);
+}
+
 frag_allocator_t* frag_group_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, frag_allocator_t* delegate) {
   return group_create(owner, name, needs_lock, delegate);
 }
 
+frag_allocator_t* frag_object_cache_allocator_create(frag_allocator_t* owner,
+                                                     const char* name,
+                                                     bool needs_lock,
+                                                     frag_allocator_t* delegate,
+                                                     size_t object_size,
+                                                     size_t object_alignment,
+                                                     frag_object_ctor_t ctor,
+                                                     frag_object_dtor_t dtor,
+                                                     void* user_data) {
+  return object_cache_create(owner, name, needs_lock, delegate, object_size, object_alignment, ctor, dtor, user_data);
+}
+
 void* operator new(size_t size, frag_allocator_t* allocator, const char* file, int line, const char* func) {
   return frag_alloc(allocator, size);
 }
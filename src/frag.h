@@ -9,6 +9,58 @@ extern "C" {
 // An allocator instance from which you can manage memory.
 typedef struct frag_allocator_t frag_allocator_t;
 
+typedef struct frag_allocator_stats_t {
+  // The number of bytes currently allocated (including overhead)
+  size_t bytes;
+
+  // The number of allocations currently active.
+  size_t count;
+
+  // The peak number of bytes allocated (including overhead).
+  size_t bytes_peak;
+
+  // The peak number of allocations.
+  size_t count_peak;
+} frag_allocator_stats_t;
+
+// The most size classes an allocator can report in its layout.
+#define FRAG_LAYOUT_MAX_SIZE_CLASSES 64
+
+// How many blocks of one size an allocator has handed out and has ready to hand out.
+typedef struct frag_size_class_t {
+  // The size of the blocks in this class.
+  size_t block_size;
+
+  // The number of blocks in use.
+  size_t used_count;
+
+  // The number of free blocks.
+  size_t free_count;
+} frag_size_class_t;
+
+// A picture of how an allocator's memory is laid out, for telling how fragmented it is.
+typedef struct frag_allocator_layout_t {
+  // The number of bytes the allocator is holding from its source (e.g. committed pages or the buffer it was given).
+  size_t committed_bytes;
+
+  // The number of those bytes that are free to be allocated.
+  size_t free_bytes;
+
+  // The size of the largest allocation that would fit without getting more memory from the source.
+  size_t largest_free_block;
+
+  // The number of separate free blocks.
+  size_t free_block_count;
+
+  // How fragmented the free memory is, from 0 (it's all in one block) to 1 (it's in many tiny pieces). This is
+  // filled in by frag as 1 - largest_free_block / free_bytes.
+  double fragmentation;
+
+  // Occupancy of each size class, for allocators that have them, smallest first.
+  unsigned int size_class_count;
+  frag_size_class_t size_classes[FRAG_LAYOUT_MAX_SIZE_CLASSES];
+} frag_allocator_layout_t;
+
 // This structure is used to describe how to create an allocator. Generally this is only needed if you are writing a
 // custom allocator implementation that is not supported by this library.
 typedef struct frag_allocator_desc_t {
@@ -30,26 +82,48 @@ typedef struct frag_allocator_desc_t {
   // The function to call when destroying this allocator.
   void (*shutdown)(frag_allocator_t* allocator);
 
-  // Extra memory to allocate with the allocator for use by the custom implementation.
-  size_t impl_size_bytes;
-} frag_allocator_desc_t;
+  // Optional. The function to call to return idle memory held by this allocator back to its source (e.g. the OS). At
+  // least `keep_bytes` of idle memory should be kept around and no more than `max_release_bytes` should be released in a
+  // single call so that incremental trims can bound their latency. Returns the number of bytes released.
+  size_t (*trim)(frag_allocator_t* allocator, size_t keep_bytes, size_t max_release_bytes);
 
-typedef struct frag_allocator_stats_t {
-  // The number of bytes currently allocated (including overhead)
-  size_t bytes;
+  // Optional. The function to call to allocate zeroed memory using this allocator. Allocators that know which of their
+  // memory is already zero (e.g. freshly mapped pages) can use this to avoid clearing it again. If this is not given, the
+  // memory is allocated with `alloc` and cleared.
+  void* (*alloc_zero)(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* allocated_size);
 
-  // The number of allocations currently active.
-  size_t count;
+  // Optional. The function to call to get the stats for this allocator. Allocators that give this keep track of their own
+  // stats (e.g. because they are shared with other processes) and frag will not count their allocations itself.
+  void (*query_stats)(const frag_allocator_t* allocator, frag_allocator_stats_t* stats);
 
-  // The peak number of bytes allocated (including overhead).
-  size_t bytes_peak;
+  // Optional. The function to call to change the size of an allocation without moving it. Returns false (leaving the
+  // allocation as it was) if that isn't possible, otherwise returns true and gives the allocated size before and after.
+  bool (*resize)(frag_allocator_t* allocator, void* ptr, size_t size, size_t* size_allocated_before, size_t* size_allocated);
 
-  // The peak number of allocations.
-  size_t count_peak;
-} frag_allocator_stats_t;
+  // Optional. The function to call to get how many bytes of an allocation can actually be used, which may be more than
+  // were asked for. If this is not given, `get_size` is used.
+  size_t (*usable_size)(const frag_allocator_t* allocator, void* ptr);
+
+  // Optional. The function to call to free memory when the caller knows the size and alignment it was allocated with,
+  // which can save looking them up. Returns the allocated size that was freed. If this is not given, `free` is used.
+  size_t (*free_sized)(frag_allocator_t* allocator, void* ptr, size_t size, size_t alignment, const char* file, int line, const char* func);
+
+  // Optional. The function to call to describe how the allocator's memory is laid out (see frag_allocator_layout_t).
+  // The layout is cleared before this is called and `fragmentation` is filled in afterwards. Allocators that manage
+  // their own memory should give this.
+  void (*query_layout)(const frag_allocator_t* allocator, frag_allocator_layout_t* layout);
+
+  // Optional. The allocator this one passes its allocations through to, if any. Budgets on the allocators above this
+  // one stop covering it at the first one that `delegate` is also under, since its memory is already counted there.
+  frag_allocator_t* delegate;
+
+  // Extra memory to allocate with the allocator for use by the custom implementation.
+  size_t impl_size_bytes;
+} frag_allocator_desc_t;
 
 typedef struct frag_debug_alloc_info_t {
   void* ptr;
+  size_t size;
   const char* file;
   const char* func;
   int line;
@@ -60,9 +134,45 @@ typedef struct frag_leak_report_t {
   unsigned int alloc_count;
 } frag_leak_report_t;
 
+typedef enum frag_guard_fault_kind_t {
+  // The fault couldn't be matched to an allocation.
+  FRAG_GUARD_FAULT_UNKNOWN,
+
+  // Memory past the end of an allocation was accessed.
+  FRAG_GUARD_FAULT_OVERFLOW,
+
+  // Memory before the start of an allocation was accessed.
+  FRAG_GUARD_FAULT_UNDERFLOW,
+
+  // An allocation was accessed after it was freed.
+  FRAG_GUARD_FAULT_USE_AFTER_FREE,
+
+  // An allocation was freed twice.
+  FRAG_GUARD_FAULT_DOUBLE_FREE,
+
+  // A pointer that was never allocated was freed.
+  FRAG_GUARD_FAULT_INVALID_FREE,
+} frag_guard_fault_kind_t;
+
+// Describes a memory error caught by a guarded allocator. Where the allocation is known, `ptr` and `size` describe it
+// along with where it was allocated and (if it has been) freed.
+typedef struct frag_guard_fault_t {
+  frag_guard_fault_kind_t kind;
+  const void* address;
+  const void* ptr;
+  size_t size;
+  const char* alloc_file;
+  const char* alloc_func;
+  int alloc_line;
+  const char* free_file;
+  const char* free_func;
+  int free_line;
+} frag_guard_fault_t;
+
 typedef void (*frag_assert_handler_t)(const char* file, int line, const char* func, const char* expression, const char* message);
 typedef void (*frag_report_out_of_memory_handler_t)(const frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func);
 typedef void (*frag_report_leak_handler_t)(const frag_allocator_t* allocator, const frag_leak_report_t* report);
+typedef void (*frag_report_guard_fault_handler_t)(const frag_allocator_t* allocator, const frag_guard_fault_t* fault);
 
 typedef struct frag_config_t {
   // The handler to use for assertion failures.
@@ -74,6 +184,10 @@ typedef struct frag_config_t {
   // The handler to use to report memory exhaustion.
   frag_report_out_of_memory_handler_t report_out_of_memory;
 
+  // The handler to use to report a memory error caught by a guarded allocator. For invalid accesses this is called from
+  // inside the SIGSEGV/SIGBUS handler and the process carries on crashing as normal once it returns.
+  frag_report_guard_fault_handler_t report_guard_fault;
+
   // The default alignment to use if no alignment is specified (by giving zero).
   size_t default_alignment;
 
@@ -108,20 +222,34 @@ void* frag_alloc_zero_ex(frag_allocator_t* allocator,
                          int line,
                          const char* func);
 
-// Reallocates memory from the given allocator. This is the extended API for when you need full control. Generally
-// you'll want to use the frag_realloc() macro.
+// Reallocates memory from the given allocator, growing or shrinking it in place if the allocator can. If the new memory
+// can't be allocated, NULL is returned and the original allocation is left alone. This is the extended API for when you
+// need full control. Generally you'll want to use the frag_realloc() macro.
 void* frag_realloc_ex(frag_allocator_t* allocator, void* ptr, size_t size, size_t alignment, const char* file, int line, const char* func);
 
 // Frees memory allocated with frag_alloc. This is the extended API for when you want full control. Generally, you'll
 // want to use frag_free() instead.
 void frag_free_ex(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func);
 
+// Frees memory allocated with frag_alloc when the size and alignment it was allocated with are known, which lets some
+// allocators skip looking them up. This is the extended API for when you want full control. Generally, you'll want to
+// use frag_free_sized() instead.
+void frag_free_sized_ex(frag_allocator_t* allocator, void* ptr, size_t size, size_t alignment, const char* file, int line, const char* func);
+
 // Allocates memory with default alignment from the given allocator.
 #define frag_alloc(allocator, size) frag_alloc_ex(allocator, size, 0, __FILE__, __LINE__, __func__)
 
 // Allocates aligned memory from the given allocator.
 #define frag_alloc_aligned(allocator, size, alignment) frag_alloc_ex(allocator, size, alignment, __FILE__, __LINE__, __func__)
 
+// Tries to change the size of an allocation without moving it. Returns false, leaving the allocation untouched, if the
+// allocator can't. This is the extended API for when you want full control. Generally you'll want to use the
+// frag_resize() macro.
+bool frag_resize_ex(frag_allocator_t* allocator, void* ptr, size_t size, const char* file, int line, const char* func);
+
+// Gets how many bytes of the given allocation can be used, which may be more than were asked for.
+size_t frag_usable_size(frag_allocator_t* allocator, void* ptr);
+
 // Allocates memory with default alignment from the given allocator that is zeroed.
 #define frag_alloc_zero(allocator, size) frag_alloc_zero_ex(allocator, size, 0, __FILE__, __LINE__, __func__)
 
@@ -136,12 +264,104 @@ void frag_free_ex(frag_allocator_t* allocator, void* ptr, const char* file, int
 // If size is zero, this acts like frag_free().
 #define frag_realloc_aligned(allocator, ptr, size, alignment) frag_realloc_ex(allocator, ptr, size, alignment, __FILE__, __LINE__, __func__)
 
+// Tries to change the size of an allocation without moving it.
+#define frag_resize(allocator, ptr, size) frag_resize_ex(allocator, ptr, size, __FILE__, __LINE__, __func__)
+
 // Frees memory from the given allocator.
 #define frag_free(allocator, ptr) frag_free_ex(allocator, ptr, __FILE__, __LINE__, __func__)
 
+// Frees memory with default alignment of the given size from the given allocator.
+#define frag_free_sized(allocator, ptr, size) frag_free_sized_ex(allocator, ptr, size, 0, __FILE__, __LINE__, __func__)
+
+// Frees memory from the given allocator once no thread can still be reading it. Readers mark the sections in which they
+// may be using shared memory with frag_epoch_enter() and frag_epoch_exit(). Retired memory is batched per thread and
+// freed in bulk from whichever thread reclaims it, so the allocator must be safe to use from other threads. This is the
+// extended API for when you want full control. Generally you'll want to use frag_free_deferred() instead.
+void frag_free_deferred_ex(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func);
+
+// Frees memory from the given allocator once no reader can still be using it.
+#define frag_free_deferred(allocator, ptr) frag_free_deferred_ex(allocator, ptr, __FILE__, __LINE__, __func__)
+
+// Enters a read-side section on the calling thread. Memory passed to frag_free_deferred() by any thread is not freed
+// until every thread that was inside a read-side section at the time has exited it. Sections can be nested.
+void frag_epoch_enter();
+
+// Exits a read-side section on the calling thread.
+void frag_epoch_exit();
+
+// Frees whatever retired memory is safe to free without waiting. Does nothing if another thread is already collecting.
+void frag_epoch_collect();
+
+// Blocks until everything the calling thread has retired so far (including its partial batch), and every batch other
+// threads had handed off by the time it was called, has been freed. Memory retired while it waits is left for later so
+// it returns even while other threads keep retiring. This must not be called from inside a read-side section.
+void frag_epoch_synchronize();
+
+// Starts a background thread that frees retired memory every `interval_msec` milliseconds, so writers never have to.
+void frag_epoch_reclaimer_start(unsigned int interval_msec);
+
+// Stops the background reclaimer thread. This also happens when the library is shut down.
+void frag_epoch_reclaimer_stop();
+
+// Starts writing a timeline of every allocation, free and reset (e.g. a frame being recycled) to `path` in the Chrome
+// trace event JSON format, which can be opened in Perfetto (https://ui.perfetto.dev) or chrome://tracing. Every
+// allocator's stats are also sampled as counters every `counter_interval_msec` milliseconds. Events are buffered per
+// thread without locking and written out by a background thread. If a thread produces them faster than they can be
+// written the excess is dropped and counted. Returns false if the file can't be opened.
+bool frag_trace_start(const char* path, unsigned int counter_interval_msec);
+
+// Stops the running trace and finishes writing the file. This also happens when the library is shut down.
+void frag_trace_stop();
+
+// A copy of the live allocations across every allocator at a point in time (see frag_snapshot_take()).
+typedef struct frag_snapshot_t frag_snapshot_t;
+
+// The allocations made from a single call site into a single allocator.
+typedef struct frag_snapshot_site_t {
+  const char* allocator_name;
+  const char* file;
+  const char* func;
+  int line;
+  size_t count;
+  size_t bytes;
+} frag_snapshot_site_t;
+
+// The allocations that are live in one snapshot but weren't in an earlier one, grouped by call site and sorted with the
+// most bytes first. The totals cover every site.
+typedef struct frag_snapshot_diff_t {
+  const frag_snapshot_site_t* sites;
+  unsigned int site_count;
+  size_t count;
+  size_t bytes;
+} frag_snapshot_diff_t;
+
+// Captures every live allocation in every allocator. Only allocations tracked with enable_detailed_leak_reports are
+// included. The snapshot is compact and sorted, so taking one regularly (e.g. every minute) and diffing it against the
+// last is a cheap way to find call sites whose memory keeps growing. The snapshot must be freed with
+// frag_snapshot_free().
+frag_snapshot_t* frag_snapshot_take();
+
+// Frees a snapshot.
+void frag_snapshot_free(frag_snapshot_t* snapshot);
+
+// Gets the number of allocations in a snapshot and the bytes they use.
+void frag_snapshot_totals(const frag_snapshot_t* snapshot, size_t* count, size_t* bytes);
+
+// Finds the allocations in `after` that aren't in `before`. The diff must be freed with frag_snapshot_diff_free() and
+// doesn't depend on either snapshot once it's been made.
+frag_snapshot_diff_t* frag_snapshot_diff(const frag_snapshot_t* before, const frag_snapshot_t* after);
+
+// Frees a snapshot diff.
+void frag_snapshot_diff_free(frag_snapshot_diff_t* diff);
+
 // Gets the system allocator.
 frag_allocator_t* frag_system_allocator();
 
+// Gets the allocator that holds frag's own bookkeeping (detailed leak tracking tables, snapshots, epoch batches). It
+// carves everything out of one reserved region so that overhead stays together and shows up in its own stats instead
+// of being mixed into the system allocator's. Its allocations are never tracked in detail themselves.
+frag_allocator_t* frag_metadata_allocator();
+
 // Allocate an custom allocator not already defined by this library. The memory for the allocator struct itself will be
 // allocated from the `owner` allocator.
 frag_allocator_t* frag_allocator_create(frag_allocator_t* owner, const frag_allocator_desc_t* desc);
@@ -149,20 +369,168 @@ frag_allocator_t* frag_allocator_create(frag_allocator_t* owner, const frag_allo
 // Destroys the given allocator.
 void frag_allocator_destroy(frag_allocator_t* owner, frag_allocator_t* allocator);
 
+// Called when an allocator's usage crosses its soft limit (see frag_allocator_set_budget()) with the number of bytes now
+// allocated. This is called after the allocator has been unlocked so the handler can free memory back to it (e.g. by
+// evicting from a cache). Allocators that pass their allocations through to this one may still be locked though.
+typedef void (*frag_pressure_handler_t)(frag_allocator_t* allocator, size_t bytes, size_t soft_limit, void* user_data);
+
+// Sets the byte budget for the given allocator (zero means no limit). Crossing `soft_limit` calls the allocator's
+// pressure handler once, and again each time usage drops back below it and then crosses it again. Allocations that
+// would take usage past `hard_limit` fail and are reported through report_out_of_memory. Allocators pass their
+// allocations through to their delegates, so a budget on an allocator covers everything that uses it. It also covers
+// the allocators created from it, together and however they were created, so allocating from one checks the budgets of
+// all the allocators it was created under. Their pressure handlers are called with the allocator the budget is on.
+void frag_allocator_set_budget(frag_allocator_t* allocator, size_t soft_limit, size_t hard_limit);
+
+// Sets the handler to call when the given allocator crosses its soft limit.
+void frag_allocator_set_pressure_handler(frag_allocator_t* allocator, frag_pressure_handler_t handler, void* user_data);
+
+// Returns idle memory held by the given allocator back to its source, keeping up to `keep_bytes` of it cached for
+// reuse. Returns the number of bytes released. Allocators that don't support trimming release nothing.
+size_t frag_allocator_trim(frag_allocator_t* allocator, size_t keep_bytes);
+
+// Like frag_allocator_trim() but releases memory in small steps and stops once `time_budget_usec` microseconds have
+// passed. This is meant to be called periodically (e.g. between traffic peaks) without causing a latency spike.
+size_t frag_allocator_trim_incremental(frag_allocator_t* allocator, size_t keep_bytes, unsigned int time_budget_usec);
+
 // Creates a stack allocator that works from a fixed buffer
 frag_allocator_t* frag_fixed_stack_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, char* buf, size_t buf_size);
 
+// Creates a frame allocator that splits the given buffer evenly into `frame_count` frames and bump allocates from the
+// current one. Memory lives until its frame is recycled `frame_count` advances later (e.g. with two frames, data
+// allocated this tick can still be consumed during the next one). Every allocation must still be freed before its
+// frame is recycled. Anything that hasn't been is passed to the config's report_leak handler (which asserts by default)
+// and then released along with the frame. With enable_detailed_leak_reports on, recycling a frame also scans all of the
+// allocator's tracked allocations to find the ones in that frame.
+frag_allocator_t* frag_frame_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, char* buf, size_t buf_size, unsigned int frame_count);
+
+// Moves a frame allocator on to its next frame, releasing everything in the oldest frame in one go.
+void frag_frame_allocator_advance(frag_allocator_t* allocator);
+
+// Gets the stats for a single frame of a frame allocator. Pass 0 for the current frame, 1 for the one before, etc.
+void frag_frame_allocator_stats(const frag_allocator_t* allocator, unsigned int frames_ago, frag_allocator_stats_t* stats);
+
+// Creates a stack allocator that reserves `reserve_size` bytes of address space up front and commits pages on demand as
+// the stack grows, so pointers stay stable and physical memory tracks actual use. When freeing, committed pages more than
+// `decommit_slack` bytes above the top of the stack are returned to the OS (pass SIZE_MAX to never decommit on free).
+frag_allocator_t* frag_vm_stack_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, size_t reserve_size, size_t decommit_slack);
+
+// Creates a buddy allocator that hands out blocks from the range [base, base + size) without ever reading or writing
+// it, which makes it suitable for memory-mapped files, GPU buffers and the like. All bookkeeping is kept in a small
+// table allocated from `owner`. Blocks are powers of 2 no smaller than `min_block_size` (which must be a power of 2) and
+// allocating and freeing are O(log n). `base` must be aligned to at least the largest alignment that will be requested.
+frag_allocator_t* frag_buddy_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, void* base, size_t size, size_t min_block_size);
+
+// Creates an allocator that lives in a new named shared memory segment (see shm_open) with `size` bytes of usable
+// space. Other processes can attach to it with frag_shm_allocator_attach() and then memory allocated in one process can
+// be freed in another. The stats are shared by every attached process and leaks are reported when the last one
+// detaches. The segment name is removed when the allocator that created it is destroyed.
+frag_allocator_t* frag_shm_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, const char* shm_name, size_t size);
+
+// Attaches to a shared memory segment created with frag_shm_allocator_create().
+frag_allocator_t* frag_shm_allocator_attach(frag_allocator_t* owner, const char* name, bool needs_lock, const char* shm_name);
+
+// The segment is mapped at a different address in each process, so pointers need to be converted to offsets before
+// they're handed to another process (and back again on the other side).
+size_t frag_shm_allocator_ptr_to_offset(const frag_allocator_t* allocator, const void* ptr);
+void* frag_shm_allocator_offset_to_ptr(const frag_allocator_t* allocator, size_t offset);
+
+// Called by frag_persistent_allocator_relocate() to fix up the pointers stored in a persistent arena. Every pointer into
+// the arena needs `delta` bytes added to it. `root` has already been adjusted.
+typedef void (*frag_persistent_relocate_func_t)(frag_allocator_t* allocator, void* root, ptrdiff_t delta, void* user_data);
+
+// Creates an allocator backed by a memory-mapped file, so that data structures built in it can be mapped straight back
+// in by a later run with no deserialization. If the file doesn't exist it is created with `size` bytes of usable space
+// (otherwise `size` is ignored). The file is mapped at `base_address` if that's free, or for an existing file wherever
+// it was mapped last time when `base_address` is NULL. The stats are stored in the file and carry over between runs.
+// Live allocations are only reported as leaks on destroy if no root has been set. Detailed leak reports list the
+// allocations made by earlier runs too, but only by address and size since where they were made isn't stored.
+frag_allocator_t* frag_persistent_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, const char* path, size_t size, void* base_address);
+
+// Gets or sets the object that later runs start from when reading the arena. The root is stored as an offset so it is
+// valid even if the arena moves.
+void* frag_persistent_allocator_root(const frag_allocator_t* allocator);
+void frag_persistent_allocator_set_root(frag_allocator_t* allocator, void* root);
+
+// Gets how far the arena has moved since its pointers were last valid. If this isn't zero the pointers stored in it
+// need fixing up with frag_persistent_allocator_relocate() before they're followed.
+ptrdiff_t frag_persistent_allocator_relocation_delta(const frag_allocator_t* allocator);
+
+// Calls `func` to fix up the pointers in the arena if it has moved and then records the new address as valid. This must
+// be done before anything else uses the arena. `func` may allocate from the arena.
+void frag_persistent_allocator_relocate(frag_allocator_t* allocator, frag_persistent_relocate_func_t func, void* user_data);
+
+// Writes the arena out to its file and waits for it to finish. Returns false if that failed.
+bool frag_persistent_allocator_flush(frag_allocator_t* allocator);
+
+// Creates an allocator that passes everything through to `delegate` except for roughly one in every `sample_rate`
+// allocations (zero disables sampling), which are each given their own page surrounded by inaccessible guard pages. Up
+// to `slot_count` sampled allocations can be live at once. Freed slots are left inaccessible until they are reused, in
+// the order they were freed. Overflows and use after free of sampled allocations fault immediately and are reported
+// through the config's report_guard_fault handler along with where the memory was allocated and freed. This is cheap
+// enough to leave on in production. Sampled allocations must fit in a page.
+frag_allocator_t* frag_guarded_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, frag_allocator_t* delegate, unsigned int slot_count, unsigned int sample_rate);
+
 // Creates a group allocator that is just a thin wrapper around another allocator but conceptually groups them together.
 frag_allocator_t* frag_group_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, frag_allocator_t* delegate);
 
+// Called by an object cache to construct an object the first time its memory is handed out. Returns false if the
+// object couldn't be constructed, which fails the allocation without reporting it as running out of memory.
+typedef bool (*frag_object_ctor_t)(void* object, void* user_data);
+
+// Called by an object cache to destruct a free object when the memory it lives in is given back.
+typedef void (*frag_object_dtor_t)(void* object, void* user_data);
+
+// Creates an allocator that caches objects of one type in their constructed state. Objects are carved out of slabs
+// allocated from `delegate` and `ctor` is only called the first time each one is handed out. Freed objects go back on
+// the cache still constructed, so they must be left in a state that's ready for reuse (e.g. a mutex unlocked, a buffer
+// cleared but not released). `dtor` only runs when an empty slab is reclaimed by frag_allocator_trim() or when the
+// cache is destroyed. The cache isn't locked while it allocates from `delegate`, so a pressure handler on `delegate`
+// (see frag_allocator_set_pressure_handler()) can trim it to give the memory back when it runs low. Allocations can't
+// be bigger than `object_size` or more aligned than `object_alignment` (which is at least 16). `ctor` and `dtor` are
+// optional, may be called with the cache locked and must not use it. See frag_object_cache.h for a C++ wrapper.
+frag_allocator_t* frag_object_cache_allocator_create(frag_allocator_t* owner,
+                                                     const char* name,
+                                                     bool needs_lock,
+                                                     frag_allocator_t* delegate,
+                                                     size_t object_size,
+                                                     size_t object_alignment,
+                                                     frag_object_ctor_t ctor,
+                                                     frag_object_dtor_t dtor,
+                                                     void* user_data);
+
 // Gets the stats for the given allocator.
 void frag_allocator_stats(const frag_allocator_t* allocator, frag_allocator_stats_t* stats);
 
+// Gets how the given allocator's memory is laid out: how much it holds, how much of that is free and how broken up the
+// free memory is. This walks the allocator's bookkeeping so it's meant for periodic monitoring (e.g. to decide when to
+// trim), not hot paths. Returns false, leaving `layout` cleared, if the allocator can't describe its layout (e.g.
+// allocators that pass everything on to another one).
+bool frag_allocator_fragmentation(const frag_allocator_t* allocator, frag_allocator_layout_t* layout);
+
+// Allocates a coroutine frame (or anything else short lived) from the calling thread's frame pool. Frames are recycled
+// by size so a thread that keeps spawning the same coroutines stops hitting the system allocator once it has warmed up.
+// The pool's memory comes from the system allocator. See frag_coroutine.h for the C++20 coroutine support built on this.
+void* frag_coroutine_frame_alloc(size_t size);
+
+// Frees a frame from frag_coroutine_frame_alloc() back to the calling thread's pool. `size` must be the size it was
+// allocated with. It may be freed on a different thread to the one that allocated it.
+void frag_coroutine_frame_free(void* ptr, size_t size);
+
+// Releases the frames the calling thread's pool is holding on to back to the system allocator. This also happens when
+// the thread exits or the library is shut down. Returns the number of bytes released.
+size_t frag_coroutine_frame_pool_trim();
+
 #ifdef __cplusplus
 }
 #endif
 
 #ifdef __cplusplus
+#include <cstddef>
+#include <new>
+#include <stdint.h>
+#include <type_traits>
+
 // Deletes the given object from the given allocator. This is the extended API for when you want full control. Generally
 // you'll want to use the frag_new() macro.
 template<typename T>
@@ -177,4 +545,78 @@ inline void frag_delete_ex(T* ptr, frag_allocator_t* allocator, const char* file
 // Deletes the given object from the given allocator.
 #define frag_delete(allocator, ptr) frag_delete_ex(ptr, allocator, __FILE__, __LINE__, __func__)
 
+// Arrays of types that need destroying are prefixed with their element count, padded out to keep the elements aligned.
+template<typename T>
+struct frag_array_cookie_t {
+  static const bool needed = !std::is_trivially_destructible<T>::value;
+  static const size_t size = !needed ? 0 : (alignof(T) > sizeof(size_t) ? alignof(T) : sizeof(size_t));
+  static const size_t alignment = alignof(T) > alignof(std::max_align_t) ? alignof(T) : 0;
+};
+
+// Allocates and default constructs an array of `count` objects of the given type from the given allocator in a single
+// allocation. Returns NULL if it couldn't be allocated. An exception thrown by a constructor leaves nothing behind and
+// is passed on. This is the extended API for when you want full control. Generally you'll want to use the
+// frag_new_array() macro.
+template<typename T>
+inline T* frag_new_array_ex(frag_allocator_t* allocator, size_t count, const char* file, int line, const char* func) {
+  typedef frag_array_cookie_t<T> cookie_t;
+  if (count > (SIZE_MAX - cookie_t::size) / sizeof(T)) {
+    return NULL;
+  }
+  char* mem = (char*)frag_alloc_ex(allocator, cookie_t::size + count * sizeof(T), cookie_t::alignment, file, line, func);
+  if (mem == NULL) {
+    return NULL;
+  }
+  if (cookie_t::needed) {
+    *(size_t*)(mem + cookie_t::size - sizeof(size_t)) = count;
+  }
+
+  T* array = (T*)(mem + cookie_t::size);
+  if (!std::is_trivially_default_constructible<T>::value) {
+    // if a constructor throws, the elements already built are destroyed and the memory freed like new[] would
+    size_t index = 0;
+    try {
+      for (; index < count; ++index) {
+        new (array + index) T;
+      }
+    }
+    catch (...) {
+      for (; index > 0; --index) {
+        array[index - 1].~T();
+      }
+      frag_free_sized_ex(allocator, mem, cookie_t::size + count * sizeof(T), cookie_t::alignment, file, line, func);
+      throw;
+    }
+  }
+  return array;
+}
+
+// Destroys and frees an array from frag_new_array(). This is the extended API for when you want full control. Generally
+// you'll want to use the frag_delete_array() macro.
+template<typename T>
+inline void frag_delete_array_ex(T* array, frag_allocator_t* allocator, const char* file, int line, const char* func) {
+  typedef frag_array_cookie_t<T> cookie_t;
+  if (array == NULL) {
+    return;
+  }
+  if (!cookie_t::needed) {
+    frag_free_ex(allocator, array, file, line, func);
+    return;
+  }
+
+  // destroy in reverse order of construction like delete[]
+  char* mem = (char*)array - cookie_t::size;
+  const size_t count = *(const size_t*)(mem + cookie_t::size - sizeof(size_t));
+  for (size_t index = count; index > 0; --index) {
+    array[index - 1].~T();
+  }
+  frag_free_sized_ex(allocator, mem, cookie_t::size + count * sizeof(T), cookie_t::alignment, file, line, func);
+}
+
+// Allocates and default constructs an array of `count` objects of the given type from the given allocator.
+#define frag_new_array(allocator, T, count) frag_new_array_ex<T>(allocator, count, __FILE__, __LINE__, __func__)
+
+// Destroys and frees an array from frag_new_array().
+#define frag_delete_array(allocator, array) frag_delete_array_ex(array, allocator, __FILE__, __LINE__, __func__)
+
 #endif // __cplusplus
@@ -0,0 +1,462 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+#include <utility>
+#include "frag.h"
+
+// Growable containers that allocate from a frag allocator. They ask the allocator to extend their storage in place
+// before falling back to moving it, and use the allocator's usable size of each block as their capacity so the slack an
+// allocator rounds up to isn't wasted. Everything they allocate is charged to the allocator they were given.
+
+namespace frag {
+
+// Types that can be moved to a new address with memcpy, leaving nothing to destroy behind them. Anything trivially
+// copyable qualifies. Specialize this for other types that don't care where they live (e.g. ones that only hold
+// pointers to other objects) so containers of them can be grown by copying their bytes.
+template<typename T>
+struct is_trivially_relocatable : std::integral_constant<bool, std::is_trivially_copyable<T>::value> {};
+
+// A dynamic array bound to a frag allocator.
+template<typename T>
+class vector {
+public:
+  typedef T value_type;
+  typedef T* iterator;
+  typedef const T* const_iterator;
+
+  explicit vector(frag_allocator_t* allocator)
+  : m_allocator(allocator)
+  , m_data(nullptr)
+  , m_size(0)
+  , m_capacity(0) {
+  }
+
+  vector(vector&& other)
+  : m_allocator(other.m_allocator)
+  , m_data(other.m_data)
+  , m_size(other.m_size)
+  , m_capacity(other.m_capacity) {
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_capacity = 0;
+  }
+
+  vector& operator=(vector&& other) {
+    if (this != &other) {
+      release();
+      m_allocator = other.m_allocator;
+      m_data = other.m_data;
+      m_size = other.m_size;
+      m_capacity = other.m_capacity;
+      other.m_data = nullptr;
+      other.m_size = 0;
+      other.m_capacity = 0;
+    }
+    return *this;
+  }
+
+  vector(const vector&) = delete;
+  vector& operator=(const vector&) = delete;
+
+  ~vector() {
+    release();
+  }
+
+  frag_allocator_t* allocator() const {
+    return m_allocator;
+  }
+
+  T* data() {
+    return m_data;
+  }
+  const T* data() const {
+    return m_data;
+  }
+
+  size_t size() const {
+    return m_size;
+  }
+
+  size_t capacity() const {
+    return m_capacity;
+  }
+
+  bool empty() const {
+    return m_size == 0;
+  }
+
+  T& operator[](size_t index) {
+    return m_data[index];
+  }
+  const T& operator[](size_t index) const {
+    return m_data[index];
+  }
+
+  T& back() {
+    return m_data[m_size - 1];
+  }
+  const T& back() const {
+    return m_data[m_size - 1];
+  }
+
+  iterator begin() {
+    return m_data;
+  }
+  iterator end() {
+    return m_data + m_size;
+  }
+  const_iterator begin() const {
+    return m_data;
+  }
+  const_iterator end() const {
+    return m_data + m_size;
+  }
+
+  // Makes sure there is room for at least `capacity` elements. Returns false if the memory couldn't be allocated.
+  bool reserve(size_t capacity) {
+    if (capacity <= m_capacity) {
+      return true;
+    }
+    return grow_to(capacity);
+  }
+
+  template<typename... Args>
+  T* emplace_back(Args&&... args) {
+    T* data = m_data;
+    if (m_size == m_capacity) {
+      data = alloc_growth(m_capacity > 0 ? m_capacity * 2 : initial_capacity());
+      if (data == nullptr) {
+        return nullptr;
+      }
+    }
+    if (data == m_data) {
+      T* item = new (m_data + m_size) T(std::forward<Args>(args)...);
+      ++m_size;
+      return item;
+    }
+
+    // `args` can refer to one of the elements (e.g. v.push_back(v[0])), so the new one is built before they move
+    T* item;
+    try {
+      item = new (data + m_size) T(std::forward<Args>(args)...);
+    }
+    catch (...) {
+      frag_free(m_allocator, data);
+      throw;
+    }
+    relocate_to(data);
+    ++m_size;
+    return item;
+  }
+
+  // Appends a copy of the value. Returns false if the memory couldn't be allocated.
+  bool push_back(const T& value) {
+    return emplace_back(value) != nullptr;
+  }
+  bool push_back(T&& value) {
+    return emplace_back(std::move(value)) != nullptr;
+  }
+
+  void pop_back() {
+    --m_size;
+    m_data[m_size].~T();
+  }
+
+  // Removes the element at `index` by moving the last element into its place.
+  void erase_swap(size_t index) {
+    if (index != m_size - 1) {
+      m_data[index] = std::move(m_data[m_size - 1]);
+    }
+    pop_back();
+  }
+
+  // Grows or shrinks to `size` elements, default constructing any new ones. Returns false if the memory couldn't be
+  // allocated.
+  bool resize(size_t size) {
+    if (!reserve(size)) {
+      return false;
+    }
+    while (m_size < size) {
+      new (m_data + m_size) T();
+      ++m_size;
+    }
+    while (m_size > size) {
+      pop_back();
+    }
+    return true;
+  }
+
+  void clear() {
+    while (m_size > 0) {
+      pop_back();
+    }
+  }
+
+  // Gives back whatever capacity the allocator can take back without moving the elements.
+  void shrink_to_fit() {
+    if (m_data == nullptr) {
+      return;
+    }
+    if (m_size == 0) {
+      release();
+      return;
+    }
+    if (frag_resize(m_allocator, m_data, m_size * sizeof(T))) {
+      m_capacity = frag_usable_size(m_allocator, m_data) / sizeof(T);
+    }
+  }
+
+private:
+  // anything the default alignment covers can use it, since not every allocator handles small alignments
+  static size_t alignment() {
+    return alignof(T) > alignof(std::max_align_t) ? alignof(T) : 0;
+  }
+
+  static size_t initial_capacity() {
+    return sizeof(T) >= 64 ? 1 : 64 / sizeof(T);
+  }
+
+  // Makes room for `capacity` elements in place if it can, otherwise allocates a new buffer for relocate_to() and
+  // leaves the elements where they are. Returns null if the memory couldn't be allocated.
+  T* alloc_growth(size_t capacity) {
+    const size_t size = capacity * sizeof(T);
+    if (size / sizeof(T) != capacity) {
+      return nullptr;
+    }
+    if (m_data != nullptr && frag_resize(m_allocator, m_data, size)) {
+      m_capacity = frag_usable_size(m_allocator, m_data) / sizeof(T);
+      return m_data;
+    }
+    return (T*)frag_alloc_ex(m_allocator, size, alignment(), __FILE__, __LINE__, __func__);
+  }
+
+  void relocate_to(T* data) {
+    if (m_data != nullptr) {
+      if (is_trivially_relocatable<T>::value) {
+        memcpy((void*)data, (const void*)m_data, m_size * sizeof(T));
+      }
+      else {
+        for (size_t index = 0; index < m_size; ++index) {
+          new (data + index) T(std::move(m_data[index]));
+          m_data[index].~T();
+        }
+      }
+      frag_free(m_allocator, m_data);
+    }
+    m_data = data;
+    m_capacity = frag_usable_size(m_allocator, data) / sizeof(T);
+  }
+
+  bool grow_to(size_t capacity) {
+    T* data = alloc_growth(capacity);
+    if (data == nullptr) {
+      return false;
+    }
+    if (data != m_data) {
+      relocate_to(data);
+    }
+    return true;
+  }
+
+  void release() {
+    clear();
+    if (m_data != nullptr) {
+      frag_free(m_allocator, m_data);
+      m_data = nullptr;
+      m_capacity = 0;
+    }
+  }
+
+  frag_allocator_t* m_allocator;
+  T* m_data;
+  size_t m_size;
+  size_t m_capacity;
+};
+
+// An unordered map bound to a frag allocator. The entries are kept densely packed in a frag::vector, so growing the map
+// grows that in place where possible, and a separate open addressed table of indices (linear probing) finds them.
+// Erasing moves the last entry into the hole, so pointers to entries are only stable until the map is modified.
+template<typename K, typename V, typename Hash = std::hash<K>, typename Eq = std::equal_to<K>>
+class hash_map {
+public:
+  struct entry_t {
+    K key;
+    V value;
+  };
+
+  typedef entry_t* iterator;
+  typedef const entry_t* const_iterator;
+
+  explicit hash_map(frag_allocator_t* allocator)
+  : m_entries(allocator)
+  , m_index(nullptr)
+  , m_index_mask(0) {
+  }
+
+  hash_map(hash_map&& other)
+  : m_entries(std::move(other.m_entries))
+  , m_index(other.m_index)
+  , m_index_mask(other.m_index_mask) {
+    other.m_index = nullptr;
+    other.m_index_mask = 0;
+  }
+
+  hash_map(const hash_map&) = delete;
+  hash_map& operator=(const hash_map&) = delete;
+
+  ~hash_map() {
+    if (m_index != nullptr) {
+      frag_free(m_entries.allocator(), m_index);
+    }
+  }
+
+  size_t size() const {
+    return m_entries.size();
+  }
+
+  bool empty() const {
+    return m_entries.empty();
+  }
+
+  iterator begin() {
+    return m_entries.begin();
+  }
+  iterator end() {
+    return m_entries.end();
+  }
+  const_iterator begin() const {
+    return m_entries.begin();
+  }
+  const_iterator end() const {
+    return m_entries.end();
+  }
+
+  // Makes sure `count` entries fit without growing. Returns false if the memory couldn't be allocated.
+  bool reserve(size_t count) {
+    return m_entries.reserve(count) && reserve_index(count);
+  }
+
+  V* find(const K& key) {
+    const size_t slot = find_slot(key);
+    return m_index != nullptr && m_index[slot] != 0 ? &m_entries[m_index[slot] - 1].value : nullptr;
+  }
+  const V* find(const K& key) const {
+    return const_cast<hash_map*>(this)->find(key);
+  }
+
+  // Inserts the key with the value constructed from `args` if it isn't already there. Returns the value in the map, or
+  // NULL if the memory couldn't be allocated.
+  template<typename... Args>
+  V* emplace(const K& key, Args&&... args) {
+    if (!reserve_index(m_entries.size() + 1)) {
+      return nullptr;
+    }
+    const size_t slot = find_slot(key);
+    if (m_index[slot] != 0) {
+      return &m_entries[m_index[slot] - 1].value;
+    }
+    entry_t* entry = m_entries.emplace_back(entry_t{key, V(std::forward<Args>(args)...)});
+    if (entry == nullptr) {
+      return nullptr;
+    }
+    m_index[slot] = (uint32_t)m_entries.size();
+    return &entry->value;
+  }
+
+  // Sets the value for the key, inserting it if needed. Returns false if the memory couldn't be allocated.
+  bool insert_or_assign(const K& key, const V& value) {
+    V* existing = find(key);
+    if (existing != nullptr) {
+      *existing = value;
+      return true;
+    }
+    return emplace(key, value) != nullptr;
+  }
+
+  // Returns true if the key was in the map.
+  bool erase(const K& key) {
+    size_t slot = find_slot(key);
+    if (m_index == nullptr || m_index[slot] == 0) {
+      return false;
+    }
+
+    // the last entry moves into the erased one's place, so point its slot there first
+    const uint32_t entry_index = m_index[slot] - 1;
+    const uint32_t last_index = (uint32_t)m_entries.size() - 1;
+    if (entry_index != last_index) {
+      m_index[find_slot(m_entries[last_index].key)] = entry_index + 1;
+    }
+    m_entries.erase_swap(entry_index);
+
+    // shift later entries in the probe sequence back so lookups don't stop at the hole
+    size_t hole = slot;
+    for (slot = (slot + 1) & m_index_mask; m_index[slot] != 0; slot = (slot + 1) & m_index_mask) {
+      const size_t home = Hash()(m_entries[m_index[slot] - 1].key) & m_index_mask;
+      if (((slot - home) & m_index_mask) >= ((slot - hole) & m_index_mask)) {
+        m_index[hole] = m_index[slot];
+        hole = slot;
+      }
+    }
+    m_index[hole] = 0;
+    return true;
+  }
+
+  void clear() {
+    m_entries.clear();
+    if (m_index != nullptr) {
+      memset(m_index, 0, (m_index_mask + 1) * sizeof(uint32_t));
+    }
+  }
+
+private:
+  // Finds the slot holding the key, or the empty slot it would go in.
+  size_t find_slot(const K& key) const {
+    if (m_index == nullptr) {
+      return 0;
+    }
+    size_t slot = Hash()(key) & m_index_mask;
+    while (m_index[slot] != 0 && !Eq()(m_entries[m_index[slot] - 1].key, key)) {
+      slot = (slot + 1) & m_index_mask;
+    }
+    return slot;
+  }
+
+  // Keeps the index table under 3/4 full. The entries don't move when it grows, only their indices are reinserted.
+  bool reserve_index(size_t count) {
+    if (m_index != nullptr && count * 4 <= (m_index_mask + 1) * 3) {
+      return true;
+    }
+    size_t slot_count = m_index != nullptr ? m_index_mask + 1 : 16;
+    while (count * 4 > slot_count * 3) {
+      slot_count *= 2;
+    }
+    // entries are indexed with 32 bits
+    if (count >= UINT32_MAX) {
+      return false;
+    }
+
+    uint32_t* index = (uint32_t*)frag_alloc_zero_ex(m_entries.allocator(), slot_count * sizeof(uint32_t), 0, __FILE__, __LINE__, __func__);
+    if (index == nullptr) {
+      return false;
+    }
+    if (m_index != nullptr) {
+      frag_free(m_entries.allocator(), m_index);
+    }
+    m_index = index;
+    m_index_mask = slot_count - 1;
+    for (size_t entry_index = 0; entry_index < m_entries.size(); ++entry_index) {
+      m_index[find_slot(m_entries[entry_index].key)] = (uint32_t)entry_index + 1;
+    }
+    return true;
+  }
+
+  vector<entry_t> m_entries;
+  uint32_t* m_index;
+  size_t m_index_mask;
+};
+
+} // namespace frag
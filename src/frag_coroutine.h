@@ -0,0 +1,338 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "frag.h"
+
+// C++20 coroutine support. Coroutine frames normally come from the global operator new, which frag can't see. Promise
+// types that derive from frag::promise_allocator instead take their frames from the first frag_allocator_t* argument
+// the coroutine is called with (among its first 8) or, if there isn't one, the calling thread's frame pool
+// (frag_coroutine_frame_alloc()).
+// Frames are counted per handler type so the cost of each kind of coroutine shows up in frag::coroutine_stats().
+
+namespace frag {
+
+// The frame stats for one kind of coroutine.
+struct coroutine_stats_t {
+  void add(size_t size) {
+    const size_t count_now = count.fetch_add(1, std::memory_order_relaxed) + 1;
+    const size_t bytes_now = bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    raise(count_peak, count_now);
+    raise(bytes_peak, bytes_now);
+  }
+
+  void remove(size_t size) {
+    count.fetch_sub(1, std::memory_order_relaxed);
+    bytes.fetch_sub(size, std::memory_order_relaxed);
+  }
+
+  frag_allocator_stats_t get() const {
+    frag_allocator_stats_t stats;
+    stats.bytes = bytes.load(std::memory_order_relaxed);
+    stats.count = count.load(std::memory_order_relaxed);
+    stats.bytes_peak = bytes_peak.load(std::memory_order_relaxed);
+    stats.count_peak = count_peak.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  std::atomic<size_t> bytes{0};
+  std::atomic<size_t> count{0};
+  std::atomic<size_t> bytes_peak{0};
+  std::atomic<size_t> count_peak{0};
+
+private:
+  static void raise(std::atomic<size_t>& peak, size_t value) {
+    size_t current = peak.load(std::memory_order_relaxed);
+    while (current < value && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+  }
+};
+
+// Gets the frame stats for the coroutines whose promises derive from promise_allocator<Handler>.
+template<typename Handler>
+coroutine_stats_t& coroutine_stats() {
+  static coroutine_stats_t stats;
+  return stats;
+}
+
+namespace detail {
+
+// Stands in for any coroutine argument, remembering it if it's an allocator. promise_allocator's operator new takes
+// these instead of a parameter pack because GCC can't pair a template operator new with the (never template) operator
+// delete and warns about a mismatch in every coroutine that has arguments.
+struct frame_arg_t {
+  template<typename T>
+  frame_arg_t(const T& arg)
+  : allocator(to_allocator(arg)) {
+  }
+
+  frag_allocator_t* allocator;
+
+private:
+  template<typename T>
+  static frag_allocator_t* to_allocator(const T& arg) {
+    if constexpr (std::is_convertible_v<const T&, frag_allocator_t*>) {
+      return arg;
+    }
+    else {
+      return nullptr;
+    }
+  }
+};
+
+inline frag_allocator_t* find_allocator(std::initializer_list<frame_arg_t> args) {
+  for (const frame_arg_t& arg : args) {
+    if (arg.allocator != nullptr) {
+      return arg.allocator;
+    }
+  }
+  return nullptr;
+}
+
+// sits in front of every frame to remember where it came from
+struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) frame_header_t {
+  frag_allocator_t* allocator;
+};
+
+} // namespace detail
+
+// Derive a promise type from this to allocate its coroutine frames through frag. `Handler` picks which stats the
+// frames are counted in.
+template<typename Handler = void>
+struct promise_allocator {
+  using arg_t = detail::frame_arg_t;
+
+  static void* operator new(size_t size) {
+    return allocate(size, nullptr);
+  }
+
+  static void* operator new(size_t size, arg_t a0) {
+    return allocate(size, detail::find_allocator({a0}));
+  }
+
+  static void* operator new(size_t size, arg_t a0, arg_t a1) {
+    return allocate(size, detail::find_allocator({a0, a1}));
+  }
+
+  static void* operator new(size_t size, arg_t a0, arg_t a1, arg_t a2) {
+    return allocate(size, detail::find_allocator({a0, a1, a2}));
+  }
+
+  static void* operator new(size_t size, arg_t a0, arg_t a1, arg_t a2, arg_t a3) {
+    return allocate(size, detail::find_allocator({a0, a1, a2, a3}));
+  }
+
+  static void* operator new(size_t size, arg_t a0, arg_t a1, arg_t a2, arg_t a3, arg_t a4) {
+    return allocate(size, detail::find_allocator({a0, a1, a2, a3, a4}));
+  }
+
+  static void* operator new(size_t size, arg_t a0, arg_t a1, arg_t a2, arg_t a3, arg_t a4, arg_t a5) {
+    return allocate(size, detail::find_allocator({a0, a1, a2, a3, a4, a5}));
+  }
+
+  static void* operator new(size_t size, arg_t a0, arg_t a1, arg_t a2, arg_t a3, arg_t a4, arg_t a5, arg_t a6) {
+    return allocate(size, detail::find_allocator({a0, a1, a2, a3, a4, a5, a6}));
+  }
+
+  static void* operator new(size_t size, arg_t a0, arg_t a1, arg_t a2, arg_t a3, arg_t a4, arg_t a5, arg_t a6, arg_t a7) {
+    return allocate(size, detail::find_allocator({a0, a1, a2, a3, a4, a5, a6, a7}));
+  }
+
+  static void operator delete(void* ptr, size_t size) {
+    detail::frame_header_t* header = (detail::frame_header_t*)ptr - 1;
+    if (header->allocator != nullptr) {
+      frag_free(header->allocator, header);
+    }
+    else {
+      frag_coroutine_frame_free(header, sizeof(detail::frame_header_t) + size);
+    }
+    coroutine_stats<Handler>().remove(size);
+  }
+
+private:
+  static void* allocate(size_t size, frag_allocator_t* allocator) {
+    const size_t total = sizeof(detail::frame_header_t) + size;
+    void* mem = allocator != nullptr ? frag_alloc(allocator, total) : frag_coroutine_frame_alloc(total);
+    if (mem == nullptr) {
+      throw std::bad_alloc();
+    }
+    detail::frame_header_t* header = (detail::frame_header_t*)mem;
+    header->allocator = allocator;
+    coroutine_stats<Handler>().add(size);
+    return header + 1;
+  }
+};
+
+template<typename T, typename Handler>
+class task;
+
+namespace detail {
+
+template<typename Handler>
+struct task_promise_base : promise_allocator<Handler> {
+  struct final_awaiter_t {
+    bool await_ready() noexcept {
+      return false;
+    }
+
+    template<typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+      // hand straight over to whoever was waiting so chains of tasks don't grow the stack
+      std::coroutine_handle<> continuation = handle.promise().continuation;
+      return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() noexcept {
+    }
+  };
+
+  std::suspend_always initial_suspend() noexcept {
+    return {};
+  }
+
+  final_awaiter_t final_suspend() noexcept {
+    return {};
+  }
+
+  std::coroutine_handle<> continuation;
+};
+
+template<typename T, typename Handler>
+struct task_promise : task_promise_base<Handler> {
+  task<T, Handler> get_return_object();
+
+  template<typename U>
+  void return_value(U&& value) {
+    result.template emplace<1>(std::forward<U>(value));
+  }
+
+  void unhandled_exception() {
+    result.template emplace<2>(std::current_exception());
+  }
+
+  T& get() {
+    if (result.index() == 2) {
+      std::rethrow_exception(std::get<2>(result));
+    }
+    return std::get<1>(result);
+  }
+
+  std::variant<std::monostate, T, std::exception_ptr> result;
+};
+
+template<typename Handler>
+struct task_promise<void, Handler> : task_promise_base<Handler> {
+  task<void, Handler> get_return_object();
+
+  void return_void() {
+  }
+
+  void unhandled_exception() {
+    exception = std::current_exception();
+  }
+
+  void get() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+  std::exception_ptr exception;
+};
+
+} // namespace detail
+
+// A lazily started coroutine that produces a T, with its frame allocated through frag (see promise_allocator). Pass a
+// frag_allocator_t* as one of the coroutine's arguments to choose the allocator, otherwise the frame comes from the
+// thread's frame pool. Awaiting the task runs it and resumes the awaiter when it finishes. Code that isn't a coroutine
+// can drive it with resume().
+template<typename T = void, typename Handler = void>
+class task {
+public:
+  using promise_type = detail::task_promise<T, Handler>;
+
+  explicit task(std::coroutine_handle<promise_type> handle)
+  : m_handle(handle) {
+  }
+
+  task(task&& other) noexcept
+  : m_handle(std::exchange(other.m_handle, nullptr)) {
+  }
+
+  task& operator=(task&& other) noexcept {
+    if (this != &other) {
+      if (m_handle) {
+        m_handle.destroy();
+      }
+      m_handle = std::exchange(other.m_handle, nullptr);
+    }
+    return *this;
+  }
+
+  task(const task&) = delete;
+  task& operator=(const task&) = delete;
+
+  ~task() {
+    if (m_handle) {
+      m_handle.destroy();
+    }
+  }
+
+  bool done() const {
+    return m_handle.done();
+  }
+
+  // Runs the task until it next suspends.
+  void resume() {
+    m_handle.resume();
+  }
+
+  // Gets the result of a finished task, rethrowing anything it threw.
+  decltype(auto) get() {
+    return m_handle.promise().get();
+  }
+
+  auto operator co_await() noexcept {
+    struct awaiter_t {
+      bool await_ready() noexcept {
+        return handle.done();
+      }
+
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+      }
+
+      decltype(auto) await_resume() {
+        return handle.promise().get();
+      }
+
+      std::coroutine_handle<promise_type> handle;
+    };
+    return awaiter_t{m_handle};
+  }
+
+private:
+  std::coroutine_handle<promise_type> m_handle;
+};
+
+namespace detail {
+
+template<typename T, typename Handler>
+task<T, Handler> task_promise<T, Handler>::get_return_object() {
+  return task<T, Handler>(std::coroutine_handle<task_promise>::from_promise(*this));
+}
+
+template<typename Handler>
+task<void, Handler> task_promise<void, Handler>::get_return_object() {
+  return task<void, Handler>(std::coroutine_handle<task_promise>::from_promise(*this));
+}
+
+} // namespace detail
+
+} // namespace frag
@@ -0,0 +1,73 @@
+#pragma once
+#include <new>
+#include "frag.h"
+
+// A typed front end to the object cache allocator (see frag_object_cache_allocator_create()). Objects are default
+// constructed the first time their memory is handed out and only destroyed when the cache gives the memory back, so
+// acquiring and releasing them skips the constructor and destructor entirely.
+
+namespace frag {
+
+template<typename T>
+class object_cache {
+public:
+  object_cache(frag_allocator_t* owner, const char* name, bool needs_lock, frag_allocator_t* delegate)
+  : m_owner(owner)
+  , m_allocator(frag_object_cache_allocator_create(owner, name, needs_lock, delegate, sizeof(T), alignof(T), &construct, &destruct, nullptr)) {
+  }
+
+  ~object_cache() {
+    if (m_allocator != nullptr) {
+      frag_allocator_destroy(m_owner, m_allocator);
+    }
+  }
+
+  object_cache(const object_cache&) = delete;
+  object_cache& operator=(const object_cache&) = delete;
+
+  // Takes an object from the cache. It's either newly constructed or in whatever state it was in when it was released.
+  // Throws std::bad_alloc if there's no memory for it or its constructor threw.
+  T* acquire() {
+    T* object = (T*)frag_alloc_aligned(m_allocator, sizeof(T), alignof(T));
+    if (object == nullptr) {
+      throw std::bad_alloc();
+    }
+    return object;
+  }
+
+  // Gives an object back to the cache without destroying it.
+  void release(T* object) {
+    frag_free(m_allocator, object);
+  }
+
+  // Destroys the free objects in empty slabs and gives their memory back, keeping up to `keep_bytes` of it. Returns
+  // the number of bytes released.
+  size_t trim(size_t keep_bytes = 0) {
+    return frag_allocator_trim(m_allocator, keep_bytes);
+  }
+
+  frag_allocator_t* allocator() const {
+    return m_allocator;
+  }
+
+private:
+  static bool construct(void* object, void* user_data) {
+    // the cache is C so exceptions can't pass through it
+    try {
+      new (object) T();
+      return true;
+    }
+    catch (...) {
+      return false;
+    }
+  }
+
+  static void destruct(void* object, void* user_data) {
+    ((T*)object)->~T();
+  }
+
+  frag_allocator_t* m_owner;
+  frag_allocator_t* m_allocator;
+};
+
+} // namespace frag
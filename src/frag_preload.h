@@ -0,0 +1,38 @@
+#pragma once
+#include "frag.h"
+
+// The part of frag that a frag_preload_configure() hook can use to build the allocator stack frag_preload routes
+// through. These are the preload library's own functions: it keeps the rest of its symbols to itself, so an executable
+// that also links frag has a separate copy that frag_preload never uses and doesn't need to for this.
+typedef struct frag_preload_api_t {
+  void* (*alloc_ex)(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func);
+  void (*free_ex)(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func);
+  frag_allocator_t* (*system_allocator)();
+  frag_allocator_t* (*allocator_create)(frag_allocator_t* owner, const frag_allocator_desc_t* desc);
+  void (*allocator_destroy)(frag_allocator_t* owner, frag_allocator_t* allocator);
+  void (*allocator_set_budget)(frag_allocator_t* allocator, size_t soft_limit, size_t hard_limit);
+  void (*allocator_set_pressure_handler)(frag_allocator_t* allocator, frag_pressure_handler_t handler, void* user_data);
+  size_t (*allocator_trim)(frag_allocator_t* allocator, size_t keep_bytes);
+  void (*allocator_stats)(const frag_allocator_t* allocator, frag_allocator_stats_t* stats);
+  frag_allocator_t* (*fixed_stack_allocator_create)(frag_allocator_t* owner, const char* name, bool needs_lock, char* buf, size_t buf_size);
+  frag_allocator_t* (*frame_allocator_create)(frag_allocator_t* owner, const char* name, bool needs_lock, char* buf, size_t buf_size, unsigned int frame_count);
+  frag_allocator_t* (*vm_stack_allocator_create)(frag_allocator_t* owner, const char* name, bool needs_lock, size_t reserve_size, size_t decommit_slack);
+  frag_allocator_t* (*buddy_allocator_create)(frag_allocator_t* owner, const char* name, bool needs_lock, void* base, size_t size, size_t min_block_size);
+  frag_allocator_t* (*guarded_allocator_create)(frag_allocator_t* owner, const char* name, bool needs_lock, frag_allocator_t* delegate, unsigned int slot_count, unsigned int sample_rate);
+  frag_allocator_t* (*group_allocator_create)(frag_allocator_t* owner, const char* name, bool needs_lock, frag_allocator_t* delegate);
+  frag_allocator_t* (*object_cache_allocator_create)(frag_allocator_t* owner,
+                                                     const char* name,
+                                                     bool needs_lock,
+                                                     frag_allocator_t* delegate,
+                                                     size_t object_size,
+                                                     size_t object_alignment,
+                                                     frag_object_ctor_t ctor,
+                                                     frag_object_dtor_t dtor,
+                                                     void* user_data);
+} frag_preload_api_t;
+
+// Exported from the executable as `frag_preload_configure` (e.g. by linking it with -rdynamic) to choose the allocator
+// frag_preload routes through, using only `api` to build it. `system` is the preload library's system allocator.
+// Returning NULL keeps the system allocator. It's called once, before main(), and anything it mallocs itself comes
+// from a small static buffer that's never reused.
+typedef frag_allocator_t* (*frag_preload_configure_func_t)(frag_allocator_t* system, const frag_preload_api_t* api);
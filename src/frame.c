@@ -0,0 +1,160 @@
+#include "internal.h"
+
+typedef struct frame_t {
+  bump_stack_t stack;
+  frag_allocator_stats_t stats;
+} frame_t;
+
+typedef struct frame_allocator_impl_t {
+  char* beg;
+  size_t frame_size;
+  unsigned int frame_count;
+  unsigned int current;
+  // followed by frame_count frame_t entries
+} frame_allocator_impl_t;
+
+static frame_t* get_frames(const frag_allocator_t* allocator) {
+  frame_allocator_impl_t* impl = (frame_allocator_impl_t*)allocator->impl;
+  return (frame_t*)(impl + 1);
+}
+
+static frame_t* get_frame_for_ptr(const frag_allocator_t* allocator, void* ptr) {
+  const frame_allocator_impl_t* impl = (const frame_allocator_impl_t*)allocator->impl;
+  const size_t offset = (size_t)((char*)ptr - impl->beg);
+  const size_t index = offset / impl->frame_size;
+  if (!frag_assert((char*)ptr >= impl->beg && index < impl->frame_count, "tried to free an invalid pointer")) {
+    return NULL;
+  }
+  return get_frames(allocator) + index;
+}
+
+static size_t frame_get_size(const frag_allocator_t* allocator, void* ptr) {
+  return bump_stack_get_footprint(ptr);
+}
+
+static void* frame_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  frame_allocator_impl_t* impl = (frame_allocator_impl_t*)allocator->impl;
+  frame_t* frame = get_frames(allocator) + impl->current;
+  void* ptr = bump_stack_alloc(&frame->stack, size, alignment, size_allocated);
+  if (ptr != NULL) {
+    ++frame->stats.count;
+    if (frame->stats.count > frame->stats.count_peak) {
+      frame->stats.count_peak = frame->stats.count;
+    }
+    frame->stats.bytes += *size_allocated;
+    if (frame->stats.bytes > frame->stats.bytes_peak) {
+      frame->stats.bytes_peak = frame->stats.bytes;
+    }
+  }
+  return ptr;
+}
+
+static void frame_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
+  if (ptr == NULL) {
+    return;
+  }
+  frame_t* frame = get_frame_for_ptr(allocator, ptr);
+  if (frame == NULL) {
+    return;
+  }
+  const size_t footprint = bump_stack_get_footprint(ptr);
+  --frame->stats.count;
+  frame->stats.bytes -= footprint;
+
+  // the memory is normally reclaimed in bulk when the frame is recycled, but popping the top is free so do it anyway
+  if (bump_stack_is_top(&frame->stack, ptr)) {
+    bump_stack_free(&frame->stack, ptr);
+  }
+}
+
+static bool frame_resize(frag_allocator_t* allocator, void* ptr, size_t size, size_t* size_allocated_before, size_t* size_allocated) {
+  frame_t* frame = get_frame_for_ptr(allocator, ptr);
+  if (frame == NULL || !bump_stack_resize(&frame->stack, ptr, size, size_allocated_before, size_allocated)) {
+    return false;
+  }
+  frame->stats.bytes = frame->stats.bytes - *size_allocated_before + *size_allocated;
+  if (frame->stats.bytes > frame->stats.bytes_peak) {
+    frame->stats.bytes_peak = frame->stats.bytes;
+  }
+  return true;
+}
+
+static size_t frame_usable_size(const frag_allocator_t* allocator, void* ptr) {
+  return bump_stack_usable_size(ptr);
+}
+
+static void frame_query_layout(const frag_allocator_t* allocator, frag_allocator_layout_t* layout) {
+  const frame_allocator_impl_t* impl = (const frame_allocator_impl_t*)allocator->impl;
+  const frame_t* frames = get_frames(allocator);
+  for (unsigned int index = 0; index < impl->frame_count; ++index) {
+    bump_stack_query_layout(&frames[index].stack, frames[index].stack.end, layout);
+  }
+}
+
+static void frame_shutdown(frag_allocator_t* allocator) {
+}
+
+void frame_advance(frag_allocator_t* allocator) {
+  frame_allocator_impl_t* impl = (frame_allocator_impl_t*)allocator->impl;
+  const unsigned int next = (impl->current + 1) % impl->frame_count;
+  frame_t* frame = get_frames(allocator) + next;
+
+  // anything still allocated in the oldest frame has outlived it
+  if (frame->stats.count > 0) {
+    allocator_release_range(allocator, frame->stack.beg, frame->stack.end, frame->stats.bytes, frame->stats.count);
+  }
+  trace_reset(allocator, frame->stack.beg, (size_t)(frame->stack.cur - frame->stack.beg));
+  frame->stack.cur = frame->stack.beg;
+  frame->stats.bytes = 0;
+  frame->stats.count = 0;
+  impl->current = next;
+}
+
+void frame_stats(const frag_allocator_t* allocator, unsigned int frames_ago, frag_allocator_stats_t* stats) {
+  const frame_allocator_impl_t* impl = (const frame_allocator_impl_t*)allocator->impl;
+  if (!frag_assert(frames_ago < impl->frame_count, "frame is out of range")) {
+    return;
+  }
+  const unsigned int index = (impl->current + impl->frame_count - frames_ago) % impl->frame_count;
+  *stats = get_frames(allocator)[index].stats;
+}
+
+frag_allocator_t* frame_create(frag_allocator_t* owner, const char* name, bool needs_lock, char* buf, size_t size, unsigned int frame_count) {
+  if (!frag_assert(frame_count > 0, "frame allocator needs at least one frame")) {
+    return NULL;
+  }
+
+  frag_allocator_desc_t desc = {0};
+  desc.name = name;
+  desc.needs_lock = needs_lock;
+  desc.alloc = &frame_alloc;
+  desc.free = &frame_free;
+  desc.get_size = &frame_get_size;
+  desc.shutdown = &frame_shutdown;
+  desc.resize = &frame_resize;
+  desc.usable_size = &frame_usable_size;
+  desc.query_layout = &frame_query_layout;
+  desc.impl_size_bytes = sizeof(frame_allocator_impl_t) + frame_count * sizeof(frame_t);
+  frag_allocator_t* allocator = allocator_create(owner, &desc);
+
+  frame_allocator_impl_t* impl = (frame_allocator_impl_t*)allocator->impl;
+  impl->beg = buf;
+  impl->frame_size = size / frame_count;
+  impl->frame_count = frame_count;
+  impl->current = 0;
+
+  // carve the buffer up evenly between the frames
+  frame_t* frames = get_frames(allocator);
+  for (unsigned int index = 0; index < frame_count; ++index) {
+    frame_t* frame = frames + index;
+    frame->stack.beg = buf + index * impl->frame_size;
+    frame->stack.end = frame->stack.beg + impl->frame_size;
+    frame->stack.cur = frame->stack.beg;
+    frame->stats.bytes = 0;
+    frame->stats.count = 0;
+    frame->stats.bytes_peak = 0;
+    frame->stats.count_peak = 0;
+  }
+
+  return allocator;
+}
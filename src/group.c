@@ -14,14 +14,39 @@ static void* group_alloc(frag_allocator_t* allocator, size_t size, size_t alignm
   return allocator_alloc(impl->delegate, size, alignment, file, line, func, size_allocated);
 }
 
+static void* group_alloc_zero(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  group_allocator_impl_t* impl = (group_allocator_impl_t*)allocator->impl;
+  return allocator_alloc_zero(impl->delegate, size, alignment, file, line, func, size_allocated);
+}
+
 static void group_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
   group_allocator_impl_t* impl = (group_allocator_impl_t*)allocator->impl;
   allocator_free(impl->delegate, ptr, file, line, func);
 }
 
+static bool group_resize(frag_allocator_t* allocator, void* ptr, size_t size, size_t* size_allocated_before, size_t* size_allocated) {
+  group_allocator_impl_t* impl = (group_allocator_impl_t*)allocator->impl;
+  return allocator_resize(impl->delegate, ptr, size, size_allocated_before, size_allocated);
+}
+
+static size_t group_usable_size(const frag_allocator_t* allocator, void* ptr) {
+  group_allocator_impl_t* impl = (group_allocator_impl_t*)allocator->impl;
+  return allocator_usable_size(impl->delegate, ptr);
+}
+
+static size_t group_free_sized(frag_allocator_t* allocator, void* ptr, size_t size, size_t alignment, const char* file, int line, const char* func) {
+  group_allocator_impl_t* impl = (group_allocator_impl_t*)allocator->impl;
+  return allocator_free_sized(impl->delegate, ptr, size, alignment, file, line, func);
+}
+
 static void group_shutdown(frag_allocator_t* allocator) {
 }
 
+static size_t group_trim(frag_allocator_t* allocator, size_t keep_bytes, size_t max_release_bytes) {
+  group_allocator_impl_t* impl = (group_allocator_impl_t*)allocator->impl;
+  return allocator_trim(impl->delegate, keep_bytes, max_release_bytes);
+}
+
 frag_allocator_t* group_create(frag_allocator_t* owner, const char* name, bool needs_lock, frag_allocator_t* delegate) {
   frag_allocator_desc_t desc = {0};
   desc.name = name;
@@ -30,6 +55,12 @@ frag_allocator_t* group_create(frag_allocator_t* owner, const char* name, bool n
   desc.free = &group_free;
   desc.get_size = &group_get_size;
   desc.shutdown = &group_shutdown;
+  desc.trim = &group_trim;
+  desc.alloc_zero = &group_alloc_zero;
+  desc.resize = &group_resize;
+  desc.usable_size = &group_usable_size;
+  desc.free_sized = &group_free_sized;
+  desc.delegate = delegate;
   desc.impl_size_bytes = sizeof(group_allocator_impl_t);
   frag_allocator_t* allocator = allocator_create(owner, &desc);
 
@@ -0,0 +1,355 @@
+#include <signal.h>
+#include <string.h>
+#include "internal.h"
+
+// how many guarded allocators can exist at once (the fault handler has to find them without taking a lock)
+#define GUARDED_MAX_ALLOCATORS 64
+
+enum {
+  GUARDED_SLOT_FREE,
+  GUARDED_SLOT_ALLOCATED,
+  GUARDED_SLOT_FREED,
+};
+
+typedef struct guarded_slot_t {
+  char* ptr;
+  size_t size;
+  int state;
+  const char* alloc_file;
+  const char* alloc_func;
+  int alloc_line;
+  const char* free_file;
+  const char* free_func;
+  int free_line;
+} guarded_slot_t;
+
+// The pool is laid out as [guard][slot 0][guard][slot 1]...[guard] with one page each. Sampled allocations are pushed
+// against the end of their slot so that overflows fault straight away. Slots are reused in the order they were freed so
+// freed memory stays inaccessible for as long as possible.
+typedef struct guarded_allocator_impl_t {
+  frag_allocator_t* delegate;
+  char* pool;
+  size_t pool_size;
+  size_t page_size;
+  unsigned int slot_count;
+  unsigned int sample_rate;
+  unsigned int countdown;
+  uint32_t rng;
+  unsigned int free_head;
+  unsigned int free_count;
+  guarded_slot_t* slots;
+  unsigned int* free_slots;
+} guarded_allocator_impl_t;
+
+static frag_allocator_t* s_guarded_allocators[GUARDED_MAX_ALLOCATORS];
+static struct sigaction s_prev_segv_action;
+static struct sigaction s_prev_bus_action;
+
+static bool in_pool(const guarded_allocator_impl_t* impl, const void* ptr) {
+  return (const char*)ptr >= impl->pool && (const char*)ptr < impl->pool + impl->pool_size;
+}
+
+static char* slot_page(const guarded_allocator_impl_t* impl, unsigned int index) {
+  return impl->pool + (2 * (size_t)index + 1) * impl->page_size;
+}
+
+static void fill_fault(frag_guard_fault_t* fault, frag_guard_fault_kind_t kind, const void* address, const guarded_slot_t* slot) {
+  memset(fault, 0, sizeof(*fault));
+  fault->kind = kind;
+  fault->address = address;
+  if (slot != NULL) {
+    fault->ptr = slot->ptr;
+    fault->size = slot->size;
+    fault->alloc_file = slot->alloc_file;
+    fault->alloc_func = slot->alloc_func;
+    fault->alloc_line = slot->alloc_line;
+    fault->free_file = slot->free_file;
+    fault->free_func = slot->free_func;
+    fault->free_line = slot->free_line;
+  }
+}
+
+// Works out which allocation a faulting address belongs to.
+static void classify_fault(const guarded_allocator_impl_t* impl, const char* address, frag_guard_fault_t* fault) {
+  const size_t page = (size_t)(address - impl->pool) / impl->page_size;
+  if (page % 2 == 1) {
+    const guarded_slot_t* slot = impl->slots + page / 2;
+    fill_fault(fault, slot->state == GUARDED_SLOT_FREED ? FRAG_GUARD_FAULT_USE_AFTER_FREE : FRAG_GUARD_FAULT_UNKNOWN, address, slot);
+    return;
+  }
+
+  // a guard page. allocations sit at the end of their slot so blame the one to the left first.
+  const guarded_slot_t* left = page > 0 ? impl->slots + (page / 2 - 1) : NULL;
+  const guarded_slot_t* right = page / 2 < impl->slot_count ? impl->slots + page / 2 : NULL;
+  if (left != NULL && left->state != GUARDED_SLOT_FREE) {
+    fill_fault(fault, left->state == GUARDED_SLOT_FREED ? FRAG_GUARD_FAULT_USE_AFTER_FREE : FRAG_GUARD_FAULT_OVERFLOW, address, left);
+  }
+  else if (right != NULL && right->state != GUARDED_SLOT_FREE) {
+    fill_fault(fault, right->state == GUARDED_SLOT_FREED ? FRAG_GUARD_FAULT_USE_AFTER_FREE : FRAG_GUARD_FAULT_UNDERFLOW, address, right);
+  }
+  else {
+    fill_fault(fault, FRAG_GUARD_FAULT_UNKNOWN, address, NULL);
+  }
+}
+
+static void forward_signal(int sig, siginfo_t* info, void* context, const struct sigaction* prev) {
+  if (prev->sa_flags & SA_SIGINFO) {
+    prev->sa_sigaction(sig, info, context);
+  }
+  else if (prev->sa_handler == SIG_DFL || prev->sa_handler == SIG_IGN) {
+    // put the default back and return, so the faulting instruction runs again and takes the process down as usual
+    signal(sig, SIG_DFL);
+  }
+  else {
+    prev->sa_handler(sig);
+  }
+}
+
+static void guarded_signal_handler(int sig, siginfo_t* info, void* context) {
+  for (unsigned int index = 0; index < GUARDED_MAX_ALLOCATORS; ++index) {
+    frag_allocator_t* allocator = __atomic_load_n(&s_guarded_allocators[index], __ATOMIC_ACQUIRE);
+    if (allocator == NULL) {
+      continue;
+    }
+    const guarded_allocator_impl_t* impl = (const guarded_allocator_impl_t*)allocator->impl;
+    if (in_pool(impl, info->si_addr)) {
+      frag_guard_fault_t fault;
+      classify_fault(impl, (const char*)info->si_addr, &fault);
+      allocator_report_guard_fault(allocator, &fault);
+      break;
+    }
+  }
+  forward_signal(sig, info, context, sig == SIGBUS ? &s_prev_bus_action : &s_prev_segv_action);
+}
+
+static void install_signal_handler(int sig, struct sigaction* prev) {
+  // check every time rather than once since something else may have replaced the handler in the meantime
+  struct sigaction current;
+  if (sigaction(sig, NULL, &current) == 0 && (current.sa_flags & SA_SIGINFO) && current.sa_sigaction == &guarded_signal_handler) {
+    return;
+  }
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = &guarded_signal_handler;
+  action.sa_flags = SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+  sigaction(sig, &action, prev);
+}
+
+static bool should_sample(guarded_allocator_impl_t* impl) {
+  if (impl->sample_rate == 0 || --impl->countdown > 0) {
+    return false;
+  }
+
+  // jitter the interval (keeping the same average) so allocation patterns that repeat don't always dodge sampling
+  impl->rng ^= impl->rng << 13;
+  impl->rng ^= impl->rng >> 17;
+  impl->rng ^= impl->rng << 5;
+  impl->countdown = impl->sample_rate > 1 ? 1 + impl->rng % (2 * impl->sample_rate - 1) : 1;
+  return true;
+}
+
+static void* guarded_slot_alloc(guarded_allocator_impl_t* impl, size_t size, size_t alignment, const char* file, int line, const char* func) {
+  if (size > impl->page_size || alignment > impl->page_size || impl->free_count == 0) {
+    return NULL;
+  }
+  const unsigned int index = impl->free_slots[impl->free_head];
+  char* page = slot_page(impl, index);
+  if (!vm_commit(page, impl->page_size)) {
+    return NULL;
+  }
+  impl->free_head = (impl->free_head + 1) % impl->slot_count;
+  --impl->free_count;
+
+  // zero sized allocations still need an address inside the slot
+  guarded_slot_t* slot = impl->slots + index;
+  const size_t placed_size = size > 0 ? size : 1;
+  slot->ptr = (char*)((uintptr_t)(page + impl->page_size - placed_size) & ~(uintptr_t)(alignment - 1));
+  slot->size = size;
+  slot->state = GUARDED_SLOT_ALLOCATED;
+  slot->alloc_file = file;
+  slot->alloc_func = func;
+  slot->alloc_line = line;
+  slot->free_file = NULL;
+  slot->free_func = NULL;
+  slot->free_line = 0;
+  return slot->ptr;
+}
+
+static void* guarded_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  guarded_allocator_impl_t* impl = (guarded_allocator_impl_t*)allocator->impl;
+  if (should_sample(impl)) {
+    void* ptr = guarded_slot_alloc(impl, size, alignment, file, line, func);
+    if (ptr != NULL) {
+      *size_allocated = impl->page_size;
+      return ptr;
+    }
+  }
+  return allocator_alloc(impl->delegate, size, alignment, file, line, func, size_allocated);
+}
+
+static void* guarded_alloc_zero(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  guarded_allocator_impl_t* impl = (guarded_allocator_impl_t*)allocator->impl;
+  if (should_sample(impl)) {
+    // slots are fresh pages every time so they're already zero
+    void* ptr = guarded_slot_alloc(impl, size, alignment, file, line, func);
+    if (ptr != NULL) {
+      *size_allocated = impl->page_size;
+      return ptr;
+    }
+  }
+  return allocator_alloc_zero(impl->delegate, size, alignment, file, line, func, size_allocated);
+}
+
+static void guarded_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
+  guarded_allocator_impl_t* impl = (guarded_allocator_impl_t*)allocator->impl;
+  if (!in_pool(impl, ptr)) {
+    allocator_free(impl->delegate, ptr, file, line, func);
+    return;
+  }
+
+  const size_t page = (size_t)((char*)ptr - impl->pool) / impl->page_size;
+  guarded_slot_t* slot = page % 2 == 1 ? impl->slots + page / 2 : NULL;
+  if (slot == NULL || slot->ptr != ptr || slot->state != GUARDED_SLOT_ALLOCATED) {
+    frag_guard_fault_t fault;
+    const bool is_double_free = slot != NULL && slot->ptr == ptr && slot->state == GUARDED_SLOT_FREED;
+    fill_fault(&fault, is_double_free ? FRAG_GUARD_FAULT_DOUBLE_FREE : FRAG_GUARD_FAULT_INVALID_FREE, ptr, slot);
+    fault.free_file = file;
+    fault.free_func = func;
+    fault.free_line = line;
+    allocator_report_guard_fault(allocator, &fault);
+    return;
+  }
+
+  // drop the memory and leave the page inaccessible until the slot comes round again
+  vm_decommit(slot_page(impl, (unsigned int)(page / 2)), impl->page_size);
+  slot->state = GUARDED_SLOT_FREED;
+  slot->free_file = file;
+  slot->free_func = func;
+  slot->free_line = line;
+  impl->free_slots[(impl->free_head + impl->free_count) % impl->slot_count] = (unsigned int)(page / 2);
+  ++impl->free_count;
+}
+
+static size_t guarded_get_size(const frag_allocator_t* allocator, void* ptr) {
+  const guarded_allocator_impl_t* impl = (const guarded_allocator_impl_t*)allocator->impl;
+  if (in_pool(impl, ptr)) {
+    return impl->page_size;
+  }
+  return allocator_get_size(impl->delegate, ptr);
+}
+
+static size_t guarded_free_sized(frag_allocator_t* allocator, void* ptr, size_t size, size_t alignment, const char* file, int line, const char* func) {
+  guarded_allocator_impl_t* impl = (guarded_allocator_impl_t*)allocator->impl;
+  if (in_pool(impl, ptr)) {
+    guarded_free(allocator, ptr, file, line, func);
+    return impl->page_size;
+  }
+  return allocator_free_sized(impl->delegate, ptr, size, alignment, file, line, func);
+}
+
+static bool guarded_resize(frag_allocator_t* allocator, void* ptr, size_t size, size_t* size_allocated_before, size_t* size_allocated) {
+  // sampled allocations are pinned to the end of their slot so they can't change size without moving
+  guarded_allocator_impl_t* impl = (guarded_allocator_impl_t*)allocator->impl;
+  if (in_pool(impl, ptr)) {
+    return false;
+  }
+  return allocator_resize(impl->delegate, ptr, size, size_allocated_before, size_allocated);
+}
+
+static size_t guarded_usable_size(const frag_allocator_t* allocator, void* ptr) {
+  const guarded_allocator_impl_t* impl = (const guarded_allocator_impl_t*)allocator->impl;
+  if (in_pool(impl, ptr)) {
+    const size_t page = (size_t)((char*)ptr - impl->pool) / impl->page_size;
+    return impl->slots[page / 2].size;
+  }
+  return allocator_usable_size(impl->delegate, ptr);
+}
+
+static size_t guarded_trim(frag_allocator_t* allocator, size_t keep_bytes, size_t max_release_bytes) {
+  guarded_allocator_impl_t* impl = (guarded_allocator_impl_t*)allocator->impl;
+  return allocator_trim(impl->delegate, keep_bytes, max_release_bytes);
+}
+
+static void guarded_query_layout(const frag_allocator_t* allocator, frag_allocator_layout_t* layout) {
+  // only the slot pool is described, everything else is laid out by the delegate. a slot's page is only committed while
+  // it's allocated, so the free slots hold no memory and just show up in the size class as ready to hand out.
+  const guarded_allocator_impl_t* impl = (const guarded_allocator_impl_t*)allocator->impl;
+  const size_t used_count = impl->slot_count - impl->free_count;
+  layout->committed_bytes = used_count * impl->page_size;
+  layout->size_class_count = 1;
+  layout->size_classes[0].block_size = impl->page_size;
+  layout->size_classes[0].used_count = used_count;
+  layout->size_classes[0].free_count = impl->free_count;
+}
+
+static void guarded_shutdown(frag_allocator_t* allocator) {
+  guarded_allocator_impl_t* impl = (guarded_allocator_impl_t*)allocator->impl;
+  for (unsigned int index = 0; index < GUARDED_MAX_ALLOCATORS; ++index) {
+    frag_allocator_t* expected = allocator;
+    if (__atomic_compare_exchange_n(&s_guarded_allocators[index], &expected, NULL, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+  }
+  vm_release(impl->pool, impl->pool_size);
+}
+
+frag_allocator_t* guarded_create(frag_allocator_t* owner, const char* name, bool needs_lock, frag_allocator_t* delegate, unsigned int slot_count, unsigned int sample_rate) {
+  if (!frag_assert(slot_count > 0, "a guarded allocator needs at least one slot")) {
+    return NULL;
+  }
+
+  const size_t page_size = vm_page_size();
+  const size_t pool_size = (2 * (size_t)slot_count + 1) * page_size;
+  char* pool = (char*)vm_reserve(pool_size);
+  if (!frag_assert(pool != NULL, "failed to reserve the guarded slot pool")) {
+    return NULL;
+  }
+
+  frag_allocator_desc_t desc = {0};
+  desc.name = name;
+  desc.needs_lock = needs_lock;
+  desc.alloc = &guarded_alloc;
+  desc.free = &guarded_free;
+  desc.get_size = &guarded_get_size;
+  desc.shutdown = &guarded_shutdown;
+  desc.trim = &guarded_trim;
+  desc.alloc_zero = &guarded_alloc_zero;
+  desc.resize = &guarded_resize;
+  desc.usable_size = &guarded_usable_size;
+  desc.free_sized = &guarded_free_sized;
+  desc.query_layout = &guarded_query_layout;
+  desc.delegate = delegate;
+  desc.impl_size_bytes = sizeof(guarded_allocator_impl_t) + slot_count * (sizeof(guarded_slot_t) + sizeof(unsigned int));
+  frag_allocator_t* allocator = allocator_create(owner, &desc);
+
+  guarded_allocator_impl_t* impl = (guarded_allocator_impl_t*)allocator->impl;
+  impl->delegate = delegate;
+  impl->pool = pool;
+  impl->pool_size = pool_size;
+  impl->page_size = page_size;
+  impl->slot_count = slot_count;
+  impl->sample_rate = sample_rate;
+  impl->countdown = sample_rate;
+  impl->rng = (uint32_t)(uintptr_t)pool | 1;
+  impl->free_head = 0;
+  impl->free_count = slot_count;
+  impl->slots = (guarded_slot_t*)(impl + 1);
+  impl->free_slots = (unsigned int*)(impl->slots + slot_count);
+  memset(impl->slots, 0, slot_count * sizeof(guarded_slot_t));
+  for (unsigned int index = 0; index < slot_count; ++index) {
+    impl->free_slots[index] = index;
+  }
+
+  // register with the fault handler
+  install_signal_handler(SIGSEGV, &s_prev_segv_action);
+  install_signal_handler(SIGBUS, &s_prev_bus_action);
+  bool registered = false;
+  for (unsigned int index = 0; index < GUARDED_MAX_ALLOCATORS && !registered; ++index) {
+    frag_allocator_t* expected = NULL;
+    registered = __atomic_compare_exchange_n(&s_guarded_allocators[index], &expected, allocator, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+  }
+  frag_assert(registered, "too many guarded allocators; faults in this one won't be reported");
+
+  return allocator;
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include "frag.h"
 
@@ -13,10 +14,26 @@ typedef struct frag_allocator_debug_t {
   unsigned int capacity;
 } frag_allocator_debug_t;
 
+typedef struct frag_allocator_budget_t {
+  size_t soft_limit;
+  size_t hard_limit;
+  frag_pressure_handler_t pressure_handler;
+  void* pressure_user_data;
+  bool over_soft_limit;
+
+  // what this allocator and the ones under it have allocated (see budget_parent()). allocators under this one change
+  // it with their own locks held, so it and the fields above are only accessed atomically.
+  size_t bytes;
+
+  // this allocator's own bytes as of the last time they were added to `bytes`, protected by its lock
+  size_t synced_bytes;
+} frag_allocator_budget_t;
+
 typedef struct frag_allocator_t {
   const char* name;
   frag_allocator_stats_t stats;
   frag_allocator_t* owner;
+  frag_allocator_t* delegate;
   void* mutex; // NOTE: not std::muteix here to avoid forcing everything to C++ :(
   void* impl;
 
@@ -24,16 +41,70 @@ typedef struct frag_allocator_t {
   void (*free)(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func);
   size_t (*get_size)(const frag_allocator_t* allocator, void* ptr);
   void (*shutdown)(frag_allocator_t* allocator);
+  size_t (*trim)(frag_allocator_t* allocator, size_t keep_bytes, size_t max_release_bytes);
+  void* (*alloc_zero)(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated);
+  void (*query_stats)(const frag_allocator_t* allocator, frag_allocator_stats_t* stats);
+  bool (*resize)(frag_allocator_t* allocator, void* ptr, size_t size, size_t* size_allocated_before, size_t* size_allocated);
+  size_t (*usable_size)(const frag_allocator_t* allocator, void* ptr);
+  size_t (*free_sized)(frag_allocator_t* allocator, void* ptr, size_t size, size_t alignment, const char* file, int line, const char* func);
+  void (*query_layout)(const frag_allocator_t* allocator, frag_allocator_layout_t* layout);
 
   frag_allocator_debug_t debug;
+  frag_allocator_budget_t budget;
+
+  // set by an alloc callback that fails for some reason other than running out of memory (e.g. an object cache's
+  // constructor failing) so the failure isn't reported as one
+  bool alloc_refused;
+
+  // every live allocator is linked into a global registry (see registry_for_each())
+  frag_allocator_t* registry_prev;
+  frag_allocator_t* registry_next;
 } frag_allocator_t;
 
 frag_allocator_t* allocator_init(void* buffer, size_t buffer_size_bytes, frag_allocator_t* owner, const frag_allocator_desc_t* desc);
 void* allocator_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated);
+void* allocator_alloc_zero(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated);
 void allocator_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func);
+size_t allocator_free_sized(frag_allocator_t* allocator, void* ptr, size_t size, size_t alignment, const char* file, int line, const char* func);
 size_t allocator_get_size(const frag_allocator_t* allocator, void* ptr);
+bool allocator_resize(frag_allocator_t* allocator, void* ptr, size_t size, size_t* size_allocated_before, size_t* size_allocated);
+size_t allocator_usable_size(const frag_allocator_t* allocator, void* ptr);
 void allocator_shutdown(frag_allocator_t* allocator);
+size_t allocator_trim(frag_allocator_t* allocator, size_t keep_bytes, size_t max_release_bytes);
 frag_allocator_t* allocator_create(frag_allocator_t* owner, const frag_allocator_desc_t* desc);
+void allocator_report_leak(const frag_allocator_t* allocator);
+
+// Adds an allocation the allocator already held when it was created (e.g. in a reopened persistent arena) to its leak
+// tracking, without touching its stats.
+void allocator_track_alloc(frag_allocator_t* allocator, void* ptr, size_t size, const char* file, int line, const char* func);
+void allocator_report_guard_fault(const frag_allocator_t* allocator, const frag_guard_fault_t* fault);
+void allocator_release_range(frag_allocator_t* allocator, const void* beg, const void* end, size_t bytes, size_t count);
+
+// Let an allocator drop its own lock in the middle of a call and take it back again, for work that can call back into
+// it (e.g. allocating from a delegate whose pressure handler trims this allocator). Its state must be consistent while
+// unlocked. Other calls can use it in the meantime, so anything checked before unlocking has to be checked again after
+// locking, including the budget allocator_alloc() checked before calling `alloc` (see allocator_fits_budget()). These
+// do nothing for allocators that don't need a lock.
+void allocator_unlock(frag_allocator_t* allocator);
+void allocator_lock(frag_allocator_t* allocator);
+
+// Whether `size` more bytes fits in the budget of the allocator and of every allocator it was created under.
+bool allocator_fits_budget(const frag_allocator_t* allocator, size_t size);
+
+// Calls `func` for every live allocator while holding the registry lock, so allocators can't be created or destroyed
+// until it returns.
+void registry_for_each(void (*func)(frag_allocator_t* allocator, void* user_data), void* user_data);
+
+void epoch_shutdown();
+
+void coroutine_shutdown();
+
+// Records allocation events for frag_trace_start(). These do nothing unless a trace is running.
+void trace_alloc(const frag_allocator_t* allocator, const void* ptr, size_t size);
+void trace_free(const frag_allocator_t* allocator, const void* ptr, size_t size);
+void trace_reset(const frag_allocator_t* allocator, const void* ptr, size_t size);
+void trace_allocator_shutdown(const frag_allocator_t* allocator);
+void trace_shutdown();
 
 void frag_assert_ex(const char* file, int line, const char* func, const char* expression, const char* message);
 #define frag_assert(expr, message) ((expr) ? true : (frag_assert_ex(__FILE__, __LINE__, __func__, #expr, message), false))
@@ -41,10 +112,86 @@ void frag_assert_ex(const char* file, int line, const char* func, const char* ex
 bool is_pow_2(size_t x);
 void* align_up_with_offset_ptr(void* cur, size_t alignment, size_t offset);
 
+// The bump logic behind the stack allocators. Each allocation is preceded by a small header so it can be popped again.
+typedef struct bump_stack_t {
+  char* beg;
+  char* end;
+  char* cur;
+} bump_stack_t;
+
+char* bump_stack_alloc_end(const bump_stack_t* stack, size_t size, size_t alignment);
+void* bump_stack_alloc(bump_stack_t* stack, size_t size, size_t alignment, size_t* size_allocated);
+void bump_stack_free(bump_stack_t* stack, void* ptr);
+size_t bump_stack_get_size(const bump_stack_t* stack, void* ptr);
+size_t bump_stack_get_footprint(const void* ptr);
+bool bump_stack_is_top(const bump_stack_t* stack, const void* ptr);
+bool bump_stack_resize(bump_stack_t* stack, void* ptr, size_t size, size_t* size_allocated_before, size_t* size_allocated);
+size_t bump_stack_usable_size(const void* ptr);
+void bump_stack_query_layout(const bump_stack_t* stack, const char* end, frag_allocator_layout_t* layout);
+
+// A binary buddy allocator over a range of offsets. All of the state lives in the out-of-band `tree` array (see
+// buddy_metadata_size()) and it holds no pointers, so it can live in memory shared between processes or in a file.
+typedef struct buddy_t {
+  uint8_t* tree;
+  size_t size;
+  unsigned int leaf_shift;
+  unsigned int level_count;
+} buddy_t;
+
+size_t buddy_metadata_size(size_t size, size_t min_block_size);
+void buddy_init(buddy_t* buddy, uint8_t* tree, size_t size, size_t min_block_size, bool reset);
+bool buddy_alloc(buddy_t* buddy, size_t size, size_t alignment, size_t* offset, size_t* block_size);
+size_t buddy_free(buddy_t* buddy, size_t offset);
+size_t buddy_free_sized(buddy_t* buddy, size_t offset, size_t size, size_t alignment);
+size_t buddy_block_size(const buddy_t* buddy, size_t offset);
+size_t buddy_node_size(const buddy_t* buddy, size_t node);
+void buddy_query_layout(const buddy_t* buddy, frag_allocator_layout_t* layout);
+void buddy_repair(buddy_t* buddy);
+
+// Calls `func` with the offset and block size of every allocation in the tree.
+typedef void (*buddy_alloc_func_t)(size_t offset, size_t size, void* user_data);
+void buddy_for_each_alloc(const buddy_t* buddy, buddy_alloc_func_t func, void* user_data);
+
+// Thin wrappers around the OS virtual memory functions.
+size_t vm_page_size();
+void* vm_reserve(size_t size);
+bool vm_commit(void* ptr, size_t size);
+void vm_decommit(void* ptr, size_t size);
+void vm_release(void* ptr, size_t size);
+
+frag_allocator_t* metadata_create(void* buffer, size_t buffer_size_bytes, const char* name, size_t reserve_size);
+frag_allocator_t* buddy_create(frag_allocator_t* owner, const char* name, bool needs_lock, void* base, size_t size, size_t min_block_size);
+frag_allocator_t* guarded_create(frag_allocator_t* owner, const char* name, bool needs_lock, frag_allocator_t* delegate, unsigned int slot_count, unsigned int sample_rate);
+frag_allocator_t* object_cache_create(frag_allocator_t* owner, const char* name, bool needs_lock, frag_allocator_t* delegate, size_t object_size, size_t object_alignment, frag_object_ctor_t ctor, frag_object_dtor_t dtor, void* user_data);
 frag_allocator_t* group_create(frag_allocator_t* owner, const char* name, bool needs_lock, frag_allocator_t* delegate);
 frag_allocator_t* fixed_stack_create(frag_allocator_t* owner, const char* name, bool needs_lock, char* buf, size_t size);
+frag_allocator_t* frame_create(frag_allocator_t* owner, const char* name, bool needs_lock, char* buf, size_t size, unsigned int frame_count);
+void frame_advance(frag_allocator_t* allocator);
+void frame_stats(const frag_allocator_t* allocator, unsigned int frames_ago, frag_allocator_stats_t* stats);
+frag_allocator_t* vm_stack_create(frag_allocator_t* owner, const char* name, bool needs_lock, size_t reserve_size, size_t decommit_slack);
+frag_allocator_t* shm_create(frag_allocator_t* owner, const char* name, bool needs_lock, const char* shm_name, size_t size);
+frag_allocator_t* shm_attach(frag_allocator_t* owner, const char* name, bool needs_lock, const char* shm_name);
+size_t shm_ptr_to_offset(const frag_allocator_t* allocator, const void* ptr);
+void* shm_offset_to_ptr(const frag_allocator_t* allocator, size_t offset);
+frag_allocator_t* persistent_create(frag_allocator_t* owner, const char* name, bool needs_lock, const char* path, size_t size, void* base_address);
+void* persistent_root(const frag_allocator_t* allocator);
+void persistent_set_root(frag_allocator_t* allocator, void* root);
+ptrdiff_t persistent_relocation_delta(const frag_allocator_t* allocator);
+void persistent_relocate(frag_allocator_t* allocator, frag_persistent_relocate_func_t func, void* user_data);
+bool persistent_flush(frag_allocator_t* allocator);
 frag_allocator_t* system_create(void* buffer, size_t buffer_size_bytes, const char* name, bool needs_lock);
 
+// The C library functions behind the system allocator. frag_preload points these at the real C library before
+// initializing frag, so frag's own memory never comes back through the malloc it replaces.
+typedef struct system_libc_t {
+  int (*posix_memalign)(void** ptr, size_t alignment, size_t size);
+  void* (*calloc)(size_t count, size_t size);
+  void (*free)(void* ptr);
+  size_t (*usable_size)(const void* ptr);
+} system_libc_t;
+
+void system_set_libc(const system_libc_t* libc);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,220 @@
+#include <string.h>
+#include "internal.h"
+
+// the smallest block handed out (as a power of 2)
+#define METADATA_MIN_CLASS_SHIFT 6
+
+// the minimum amount of memory to commit at a time as the region fills up
+#define METADATA_COMMIT_GRANULARITY_BYTES (64 * 1024)
+
+// Each allocation is preceded by one of these. Blocks are a power of 2 in size, so growing a table inside its block
+// never has to move it.
+typedef struct metadata_header_t {
+  uint32_t class_shift;
+  uint32_t offset;
+} metadata_header_t;
+
+typedef struct metadata_free_t {
+  struct metadata_free_t* next;
+} metadata_free_t;
+
+// There is only ever one metadata allocator so its state lives here rather than in the allocator's impl. Blocks are
+// carved off the front of a single reserved region and recycled through per size class free lists, so all of frag's
+// own bookkeeping stays together and out of the general heap.
+static char* s_region;
+static size_t s_region_size;
+static char* s_cur;
+static char* s_committed;
+static metadata_free_t* s_free_lists[64];
+static size_t s_used_counts[64];
+
+static unsigned int class_shift_for(size_t size) {
+  unsigned int shift = METADATA_MIN_CLASS_SHIFT;
+  while (((size_t)1 << shift) < size) {
+    ++shift;
+  }
+  return shift;
+}
+
+// Freed blocks bigger than a few pages hand their memory back to the OS, all except the page holding the free list link.
+static bool interior_pages(const char* block, size_t block_size, char** beg, char** end) {
+  const size_t page_size = vm_page_size();
+  if (block_size < 4 * page_size) {
+    return false;
+  }
+  *beg = (char*)(((uintptr_t)block + sizeof(metadata_free_t) + page_size - 1) & ~(page_size - 1));
+  *end = (char*)(((uintptr_t)block + block_size) & ~(page_size - 1));
+  return *end > *beg;
+}
+
+static char* take_block(unsigned int shift) {
+  const size_t block_size = (size_t)1 << shift;
+  metadata_free_t* block = s_free_lists[shift];
+  if (block != NULL) {
+    char* beg;
+    char* end;
+    if (interior_pages((char*)block, block_size, &beg, &end) && !vm_commit(beg, (size_t)(end - beg))) {
+      return NULL;
+    }
+    s_free_lists[shift] = block->next;
+    return (char*)block;
+  }
+
+  if (block_size > (size_t)(s_region + s_region_size - s_cur)) {
+    return NULL;
+  }
+  char* block_end = s_cur + block_size;
+  if (block_end > s_committed) {
+    char* commit_end = (char*)align_up_with_offset_ptr(block_end, vm_page_size(), 0);
+    if ((size_t)(commit_end - s_committed) < METADATA_COMMIT_GRANULARITY_BYTES) {
+      commit_end = s_committed + METADATA_COMMIT_GRANULARITY_BYTES;
+    }
+    if (commit_end > s_region + s_region_size) {
+      commit_end = s_region + s_region_size;
+    }
+    if (!vm_commit(s_committed, (size_t)(commit_end - s_committed))) {
+      return NULL;
+    }
+    s_committed = commit_end;
+  }
+  char* block_beg = s_cur;
+  s_cur = block_end;
+  return block_beg;
+}
+
+static metadata_header_t* get_header(void* ptr) {
+  return (metadata_header_t*)ptr - 1;
+}
+
+static size_t metadata_get_size(const frag_allocator_t* allocator, void* ptr) {
+  return (size_t)1 << get_header(ptr)->class_shift;
+}
+
+static void* metadata_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  // every block starts 16 byte aligned so anything up to that just needs room for the header
+  const size_t lead = alignment > 16 ? alignment : 16;
+  if (size > s_region_size) {
+    *size_allocated = 0;
+    return NULL;
+  }
+  const unsigned int shift = class_shift_for(size + lead);
+  char* block = take_block(shift);
+  if (block == NULL) {
+    *size_allocated = 0;
+    return NULL;
+  }
+
+  char* ptr = (char*)align_up_with_offset_ptr(block, lead, sizeof(metadata_header_t));
+  metadata_header_t* header = get_header(ptr);
+  header->class_shift = shift;
+  header->offset = (uint32_t)(ptr - block);
+  *size_allocated = (size_t)1 << shift;
+  ++s_used_counts[shift];
+  return ptr;
+}
+
+static void metadata_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
+  const metadata_header_t* header = get_header(ptr);
+  const unsigned int shift = header->class_shift;
+  metadata_free_t* block = (metadata_free_t*)((char*)ptr - header->offset);
+  block->next = s_free_lists[shift];
+  s_free_lists[shift] = block;
+  --s_used_counts[shift];
+
+  char* beg;
+  char* end;
+  if (interior_pages((char*)block, (size_t)1 << shift, &beg, &end)) {
+    vm_decommit(beg, (size_t)(end - beg));
+  }
+}
+
+static bool metadata_resize(frag_allocator_t* allocator, void* ptr, size_t size, size_t* size_allocated_before, size_t* size_allocated) {
+  const metadata_header_t* header = get_header(ptr);
+  const size_t block_size = (size_t)1 << header->class_shift;
+  if (header->offset + size > block_size) {
+    return false;
+  }
+  *size_allocated_before = block_size;
+  *size_allocated = block_size;
+  return true;
+}
+
+static size_t metadata_usable_size(const frag_allocator_t* allocator, void* ptr) {
+  const metadata_header_t* header = get_header(ptr);
+  return ((size_t)1 << header->class_shift) - header->offset;
+}
+
+static void metadata_query_layout(const frag_allocator_t* allocator, frag_allocator_layout_t* layout) {
+  // the untouched part of the committed range is free too, but anything past it has to be committed first
+  const size_t tail_bytes = (size_t)(s_committed - s_cur);
+  layout->committed_bytes = (size_t)(s_committed - s_region);
+  layout->free_bytes = tail_bytes;
+  layout->largest_free_block = tail_bytes;
+  layout->free_block_count = tail_bytes > 0 ? 1 : 0;
+
+  for (unsigned int shift = METADATA_MIN_CLASS_SHIFT; shift < 64; ++shift) {
+    const size_t block_size = (size_t)1 << shift;
+    size_t free_count = 0;
+    for (const metadata_free_t* block = s_free_lists[shift]; block != NULL; block = block->next) {
+      // big free blocks have handed most of their pages back, so only what's left counts and they can't be reused
+      // without committing them again
+      char* beg;
+      char* end;
+      size_t committed_size = block_size;
+      if (interior_pages((const char*)block, block_size, &beg, &end)) {
+        committed_size -= (size_t)(end - beg);
+        layout->committed_bytes -= (size_t)(end - beg);
+      }
+      else if (block_size > layout->largest_free_block) {
+        layout->largest_free_block = block_size;
+      }
+      layout->free_bytes += committed_size;
+      ++free_count;
+    }
+    if (free_count == 0 && s_used_counts[shift] == 0) {
+      continue;
+    }
+
+    layout->size_class_count = shift - METADATA_MIN_CLASS_SHIFT + 1;
+    frag_size_class_t* size_class = &layout->size_classes[shift - METADATA_MIN_CLASS_SHIFT];
+    size_class->used_count = s_used_counts[shift];
+    size_class->free_count = free_count;
+    layout->free_block_count += free_count;
+  }
+  for (unsigned int index = 0; index < layout->size_class_count; ++index) {
+    layout->size_classes[index].block_size = (size_t)1 << (METADATA_MIN_CLASS_SHIFT + index);
+  }
+}
+
+static void metadata_shutdown(frag_allocator_t* allocator) {
+  vm_release(s_region, s_region_size);
+  s_region = NULL;
+}
+
+frag_allocator_t* metadata_create(void* buffer, size_t buffer_size_bytes, const char* name, size_t reserve_size) {
+  const size_t page_size = vm_page_size();
+  reserve_size = (reserve_size + page_size - 1) & ~(page_size - 1);
+  char* region = (char*)vm_reserve(reserve_size);
+  if (!frag_assert(region != NULL, "failed to reserve the metadata region")) {
+    return NULL;
+  }
+  s_region = region;
+  s_region_size = reserve_size;
+  s_cur = region;
+  s_committed = region;
+  memset(s_free_lists, 0, sizeof(s_free_lists));
+  memset(s_used_counts, 0, sizeof(s_used_counts));
+
+  frag_allocator_desc_t desc = {0};
+  desc.name = name;
+  desc.needs_lock = true;
+  desc.alloc = &metadata_alloc;
+  desc.free = &metadata_free;
+  desc.get_size = &metadata_get_size;
+  desc.shutdown = &metadata_shutdown;
+  desc.resize = &metadata_resize;
+  desc.usable_size = &metadata_usable_size;
+  desc.query_layout = &metadata_query_layout;
+  desc.impl_size_bytes = 0;
+  return allocator_init(buffer, buffer_size_bytes, NULL, &desc);
+}
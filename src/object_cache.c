@@ -0,0 +1,324 @@
+#include <string.h>
+#include "internal.h"
+
+// the smallest slab to carve objects from
+#define OBJECT_CACHE_MIN_SLAB_BYTES 4096
+
+// slabs are grown until they hold at least this many objects
+#define OBJECT_CACHE_MIN_SLAB_OBJECTS 8
+
+enum {
+  OBJECT_SLAB_EMPTY,
+  OBJECT_SLAB_PARTIAL,
+  OBJECT_SLAB_FULL,
+  OBJECT_SLAB_LIST_COUNT,
+};
+
+// Each slab starts with one of these followed by a stack of the indices of its free objects, a bitmap of which objects
+// are on that stack (so freeing one twice can be caught) and then the objects themselves. The free objects have all
+// been constructed. Objects past `constructed` have never been handed out and are only constructed when they first
+// are, so a slab that's never filled never pays for its whole capacity.
+typedef struct object_slab_t {
+  struct object_slab_t* prev;
+  struct object_slab_t* next;
+  uint32_t in_use;
+  uint32_t constructed;
+  uint32_t free_count;
+  uint32_t list;
+  // followed by capacity free indices and then the free bitmap
+} object_slab_t;
+
+// Slabs are aligned to their size so the slab holding an object can be found by masking its address. They are kept
+// on empty, partial and full lists and allocations come from a partial slab (whichever changed last) before an empty
+// one, so empty slabs stay empty until they're needed and can be reclaimed. Partial slabs aren't ordered by how full
+// they are.
+typedef struct object_cache_allocator_impl_t {
+  frag_allocator_t* delegate;
+  frag_object_ctor_t ctor;
+  frag_object_dtor_t dtor;
+  void* user_data;
+  size_t object_size;
+  size_t object_alignment;
+  size_t stride;
+  size_t slab_size;
+  size_t objects_offset;
+  uint32_t capacity;
+  size_t slab_counts[OBJECT_SLAB_LIST_COUNT];
+  object_slab_t* slabs[OBJECT_SLAB_LIST_COUNT];
+} object_cache_allocator_impl_t;
+
+static uint32_t* get_free_indices(object_slab_t* slab) {
+  return (uint32_t*)(slab + 1);
+}
+
+static uint32_t* get_free_bitmap(const object_cache_allocator_impl_t* impl, object_slab_t* slab) {
+  return get_free_indices(slab) + impl->capacity;
+}
+
+static bool is_free(const object_cache_allocator_impl_t* impl, object_slab_t* slab, uint32_t index) {
+  return (get_free_bitmap(impl, slab)[index / 32] & (1u << (index % 32))) != 0;
+}
+
+static void set_free(const object_cache_allocator_impl_t* impl, object_slab_t* slab, uint32_t index, bool free) {
+  uint32_t* word = get_free_bitmap(impl, slab) + index / 32;
+  const uint32_t bit = 1u << (index % 32);
+  *word = free ? *word | bit : *word & ~bit;
+}
+
+static char* get_object(const object_cache_allocator_impl_t* impl, object_slab_t* slab, uint32_t index) {
+  return (char*)slab + impl->objects_offset + index * impl->stride;
+}
+
+static object_slab_t* get_slab_for_ptr(const object_cache_allocator_impl_t* impl, void* ptr) {
+  return (object_slab_t*)((uintptr_t)ptr & ~(uintptr_t)(impl->slab_size - 1));
+}
+
+static void slab_unlink(object_cache_allocator_impl_t* impl, object_slab_t* slab) {
+  if (slab->prev != NULL) {
+    slab->prev->next = slab->next;
+  }
+  else {
+    impl->slabs[slab->list] = slab->next;
+  }
+  if (slab->next != NULL) {
+    slab->next->prev = slab->prev;
+  }
+  --impl->slab_counts[slab->list];
+}
+
+static void slab_link(object_cache_allocator_impl_t* impl, object_slab_t* slab, uint32_t list) {
+  slab->list = list;
+  slab->prev = NULL;
+  slab->next = impl->slabs[list];
+  if (impl->slabs[list] != NULL) {
+    impl->slabs[list]->prev = slab;
+  }
+  impl->slabs[list] = slab;
+  ++impl->slab_counts[list];
+}
+
+static void slab_update_list(object_cache_allocator_impl_t* impl, object_slab_t* slab) {
+  uint32_t list = OBJECT_SLAB_PARTIAL;
+  if (slab->in_use == 0) {
+    list = OBJECT_SLAB_EMPTY;
+  }
+  else if (slab->in_use == impl->capacity) {
+    list = OBJECT_SLAB_FULL;
+  }
+  if (list != slab->list) {
+    slab_unlink(impl, slab);
+    slab_link(impl, slab, list);
+  }
+}
+
+// Destructs the slab's free objects and gives its memory back to the delegate. Returns how much the delegate got back,
+// which can be more than the slab size.
+static size_t slab_release(object_cache_allocator_impl_t* impl, object_slab_t* slab) {
+  slab_unlink(impl, slab);
+  if (impl->dtor != NULL) {
+    const uint32_t* free_indices = get_free_indices(slab);
+    for (uint32_t index = 0; index < slab->free_count; ++index) {
+      impl->dtor(get_object(impl, slab, free_indices[index]), impl->user_data);
+    }
+  }
+  const size_t size = allocator_get_size(impl->delegate, slab);
+  allocator_free(impl->delegate, slab, __FILE__, __LINE__, __func__);
+  return size;
+}
+
+static size_t object_cache_get_size(const frag_allocator_t* allocator, void* ptr) {
+  const object_cache_allocator_impl_t* impl = (const object_cache_allocator_impl_t*)allocator->impl;
+  return impl->stride;
+}
+
+static void* object_cache_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  object_cache_allocator_impl_t* impl = (object_cache_allocator_impl_t*)allocator->impl;
+  *size_allocated = 0;
+  if (!frag_assert(size <= impl->object_size, "requested size is larger than the cache's objects") ||
+      !frag_assert(alignment <= impl->object_alignment, "requested alignment is larger than the cache's objects")) {
+    return NULL;
+  }
+
+  object_slab_t* slab = impl->slabs[OBJECT_SLAB_PARTIAL];
+  if (slab == NULL) {
+    slab = impl->slabs[OBJECT_SLAB_EMPTY];
+  }
+  if (slab == NULL) {
+    // the delegate can call a pressure handler that trims this cache so it mustn't be locked while that happens
+    size_t slab_size_allocated;
+    allocator_unlock(allocator);
+    object_slab_t* new_slab = (object_slab_t*)allocator_alloc(impl->delegate, impl->slab_size, impl->slab_size, __FILE__, __LINE__, __func__, &slab_size_allocated);
+    allocator_lock(allocator);
+
+    // other calls can have used up the budget or added a slab with room while the cache was unlocked, in which case the
+    // new slab goes straight back
+    const bool fits_budget = allocator_fits_budget(allocator, size);
+    slab = impl->slabs[OBJECT_SLAB_PARTIAL] != NULL ? impl->slabs[OBJECT_SLAB_PARTIAL] : impl->slabs[OBJECT_SLAB_EMPTY];
+    if (new_slab != NULL && (!fits_budget || slab != NULL)) {
+      allocator_free(impl->delegate, new_slab, __FILE__, __LINE__, __func__);
+      new_slab = NULL;
+    }
+    if (!fits_budget) {
+      return NULL;
+    }
+    if (slab == NULL) {
+      if (new_slab == NULL) {
+        return NULL;
+      }
+      slab = new_slab;
+      slab->in_use = 0;
+      slab->constructed = 0;
+      slab->free_count = 0;
+      memset(get_free_bitmap(impl, slab), 0, (impl->capacity + 31) / 32 * sizeof(uint32_t));
+      slab_link(impl, slab, OBJECT_SLAB_EMPTY);
+    }
+  }
+
+  // reuse a constructed object if there is one, otherwise construct the next untouched one
+  char* ptr;
+  if (slab->free_count > 0) {
+    const uint32_t index = get_free_indices(slab)[--slab->free_count];
+    set_free(impl, slab, index, false);
+    ptr = get_object(impl, slab, index);
+  }
+  else {
+    ptr = get_object(impl, slab, slab->constructed);
+    if (impl->ctor != NULL && !impl->ctor(ptr, impl->user_data)) {
+      allocator->alloc_refused = true;
+      return NULL;
+    }
+    ++slab->constructed;
+  }
+  ++slab->in_use;
+  slab_update_list(impl, slab);
+
+  *size_allocated = impl->stride;
+  return ptr;
+}
+
+static void object_cache_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
+  object_cache_allocator_impl_t* impl = (object_cache_allocator_impl_t*)allocator->impl;
+  object_slab_t* slab = get_slab_for_ptr(impl, ptr);
+  const size_t offset = (size_t)((char*)ptr - (char*)slab);
+  const bool is_valid = offset >= impl->objects_offset && (offset - impl->objects_offset) % impl->stride == 0 &&
+                        (offset - impl->objects_offset) / impl->stride < slab->constructed;
+  if (!frag_assert(is_valid, "tried to free an invalid pointer")) {
+    return;
+  }
+  const uint32_t index = (uint32_t)((offset - impl->objects_offset) / impl->stride);
+  if (!frag_assert(!is_free(impl, slab, index), "tried to free an object that is already free")) {
+    return;
+  }
+
+  // the object keeps its constructed state for the next allocation
+  set_free(impl, slab, index, true);
+  get_free_indices(slab)[slab->free_count++] = index;
+  --slab->in_use;
+  slab_update_list(impl, slab);
+}
+
+static size_t object_cache_trim(frag_allocator_t* allocator, size_t keep_bytes, size_t max_release_bytes) {
+  object_cache_allocator_impl_t* impl = (object_cache_allocator_impl_t*)allocator->impl;
+  size_t released = 0;
+  while (impl->slabs[OBJECT_SLAB_EMPTY] != NULL && impl->slab_counts[OBJECT_SLAB_EMPTY] * impl->slab_size > keep_bytes &&
+         released + impl->slab_size <= max_release_bytes) {
+    released += slab_release(impl, impl->slabs[OBJECT_SLAB_EMPTY]);
+  }
+  return released;
+}
+
+static void object_cache_query_layout(const frag_allocator_t* allocator, frag_allocator_layout_t* layout) {
+  const object_cache_allocator_impl_t* impl = (const object_cache_allocator_impl_t*)allocator->impl;
+  size_t used_count = 0;
+  size_t free_count = 0;
+  for (unsigned int list = 0; list < OBJECT_SLAB_LIST_COUNT; ++list) {
+    for (const object_slab_t* slab = impl->slabs[list]; slab != NULL; slab = slab->next) {
+      used_count += slab->in_use;
+      free_count += impl->capacity - slab->in_use;
+    }
+  }
+
+  // every free slot is its own block since objects are never merged
+  layout->committed_bytes = (impl->slab_counts[OBJECT_SLAB_EMPTY] + impl->slab_counts[OBJECT_SLAB_PARTIAL] + impl->slab_counts[OBJECT_SLAB_FULL]) * impl->slab_size;
+  layout->free_bytes = free_count * impl->stride;
+  layout->largest_free_block = free_count > 0 ? impl->stride : 0;
+  layout->free_block_count = free_count;
+  layout->size_class_count = 1;
+  layout->size_classes[0].block_size = impl->stride;
+  layout->size_classes[0].used_count = used_count;
+  layout->size_classes[0].free_count = free_count;
+}
+
+static void object_cache_shutdown(frag_allocator_t* allocator) {
+  // live objects have already been reported as leaks and are left alone, only the free ones are destructed
+  object_cache_allocator_impl_t* impl = (object_cache_allocator_impl_t*)allocator->impl;
+  for (unsigned int list = 0; list < OBJECT_SLAB_LIST_COUNT; ++list) {
+    while (impl->slabs[list] != NULL) {
+      slab_release(impl, impl->slabs[list]);
+    }
+  }
+}
+
+static size_t calc_objects_offset(size_t capacity, size_t object_alignment) {
+  const size_t metadata_size = sizeof(object_slab_t) + capacity * sizeof(uint32_t) + (capacity + 31) / 32 * sizeof(uint32_t);
+  return (metadata_size + object_alignment - 1) & ~(object_alignment - 1);
+}
+
+frag_allocator_t* object_cache_create(frag_allocator_t* owner, const char* name, bool needs_lock, frag_allocator_t* delegate, size_t object_size, size_t object_alignment, frag_object_ctor_t ctor, frag_object_dtor_t dtor, void* user_data) {
+  if (object_alignment < 16) {
+    object_alignment = 16;
+  }
+  if (!frag_assert(is_pow_2(object_alignment), "alignment is not a power of 2") ||
+      !frag_assert(object_size > 0, "object size is zero")) {
+    return NULL;
+  }
+
+  // grow the slab until enough objects fit after the header, the free index stack and the free bitmap
+  const size_t stride = (object_size + object_alignment - 1) & ~(object_alignment - 1);
+  size_t slab_size = OBJECT_CACHE_MIN_SLAB_BYTES;
+  size_t capacity;
+  size_t objects_offset;
+  for (;;) {
+    capacity = (slab_size - sizeof(object_slab_t)) / (stride + sizeof(uint32_t));
+    objects_offset = calc_objects_offset(capacity, object_alignment);
+    while (capacity > 0 && objects_offset + capacity * stride > slab_size) {
+      --capacity;
+      objects_offset = calc_objects_offset(capacity, object_alignment);
+    }
+    if (capacity >= OBJECT_CACHE_MIN_SLAB_OBJECTS) {
+      break;
+    }
+    slab_size *= 2;
+  }
+
+  frag_allocator_desc_t desc = {0};
+  desc.name = name;
+  desc.needs_lock = needs_lock;
+  desc.alloc = &object_cache_alloc;
+  desc.free = &object_cache_free;
+  desc.get_size = &object_cache_get_size;
+  desc.shutdown = &object_cache_shutdown;
+  desc.trim = &object_cache_trim;
+  desc.query_layout = &object_cache_query_layout;
+  desc.delegate = delegate;
+  desc.impl_size_bytes = sizeof(object_cache_allocator_impl_t);
+  frag_allocator_t* allocator = allocator_create(owner, &desc);
+
+  object_cache_allocator_impl_t* impl = (object_cache_allocator_impl_t*)allocator->impl;
+  impl->delegate = delegate;
+  impl->ctor = ctor;
+  impl->dtor = dtor;
+  impl->user_data = user_data;
+  impl->object_size = object_size;
+  impl->object_alignment = object_alignment;
+  impl->stride = stride;
+  impl->slab_size = slab_size;
+  impl->objects_offset = objects_offset;
+  impl->capacity = (uint32_t)capacity;
+  for (unsigned int list = 0; list < OBJECT_SLAB_LIST_COUNT; ++list) {
+    impl->slab_counts[list] = 0;
+    impl->slabs[list] = NULL;
+  }
+
+  return allocator;
+}
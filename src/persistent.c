@@ -0,0 +1,217 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "internal.h"
+
+// "fragpst" followed by a layout version
+#define PERSISTENT_MAGIC 0x6672616770737401ull
+#define PERSISTENT_MIN_BLOCK_SIZE_BYTES 64
+
+// Lives at the start of the file. Everything is stored as offsets except `base`, which records where the data was
+// mapped the last time the pointers stored in it were valid.
+typedef struct persistent_header_t {
+  uint64_t magic;
+  uint64_t file_size;
+  uint64_t data_offset;
+  uint64_t data_size;
+  uint64_t base;
+  uint64_t root_offset; // offset of the root object plus one, or zero if there is none
+  frag_allocator_stats_t stats;
+  // followed by the buddy tree and then the data
+} persistent_header_t;
+
+typedef struct persistent_allocator_impl_t {
+  persistent_header_t* header;
+  char* data;
+  buddy_t buddy;
+} persistent_allocator_impl_t;
+
+static size_t persistent_get_size(const frag_allocator_t* allocator, void* ptr) {
+  const persistent_allocator_impl_t* impl = (const persistent_allocator_impl_t*)allocator->impl;
+  return buddy_block_size(&impl->buddy, (size_t)((char*)ptr - impl->data));
+}
+
+static void* persistent_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  persistent_allocator_impl_t* impl = (persistent_allocator_impl_t*)allocator->impl;
+  frag_assert(is_pow_2(alignment), "alignment is not a power of 2");
+  frag_assert(alignment <= vm_page_size(), "alignment is larger than a page");
+
+  size_t offset;
+  if (!buddy_alloc(&impl->buddy, size, alignment, &offset, size_allocated)) {
+    *size_allocated = 0;
+    return NULL;
+  }
+
+  // the stats are kept in the file so they carry over to the next time it's mapped
+  frag_allocator_stats_t* stats = &impl->header->stats;
+  ++stats->count;
+  if (stats->count > stats->count_peak) {
+    stats->count_peak = stats->count;
+  }
+  stats->bytes += *size_allocated;
+  if (stats->bytes > stats->bytes_peak) {
+    stats->bytes_peak = stats->bytes;
+  }
+  return impl->data + offset;
+}
+
+static void persistent_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
+  persistent_allocator_impl_t* impl = (persistent_allocator_impl_t*)allocator->impl;
+  const size_t size = buddy_free(&impl->buddy, (size_t)((char*)ptr - impl->data));
+  if (size > 0) {
+    --impl->header->stats.count;
+    impl->header->stats.bytes -= size;
+  }
+}
+
+static void persistent_query_stats(const frag_allocator_t* allocator, frag_allocator_stats_t* stats) {
+  const persistent_allocator_impl_t* impl = (const persistent_allocator_impl_t*)allocator->impl;
+  *stats = impl->header->stats;
+}
+
+static void persistent_query_layout(const frag_allocator_t* allocator, frag_allocator_layout_t* layout) {
+  const persistent_allocator_impl_t* impl = (const persistent_allocator_impl_t*)allocator->impl;
+  buddy_query_layout(&impl->buddy, layout);
+}
+
+static void persistent_shutdown(frag_allocator_t* allocator) {
+  persistent_allocator_impl_t* impl = (persistent_allocator_impl_t*)allocator->impl;
+  persistent_header_t* header = impl->header;
+
+  // live allocations are the whole point of the file, but without a root nothing can ever find them again
+  if (header->root_offset == 0 && header->stats.count != 0) {
+    allocator_report_leak(allocator);
+  }
+  munmap(header, (size_t)header->file_size);
+}
+
+static void track_earlier_alloc(size_t offset, size_t size, void* user_data) {
+  frag_allocator_t* allocator = (frag_allocator_t*)user_data;
+  persistent_allocator_impl_t* impl = (persistent_allocator_impl_t*)allocator->impl;
+  allocator_track_alloc(allocator, impl->data + offset, size, "(an earlier run)", 0, "unknown");
+}
+
+frag_allocator_t* persistent_create(frag_allocator_t* owner, const char* name, bool needs_lock, const char* path, size_t size, void* base_address) {
+  const int fd = open(path, O_RDWR | O_CREAT, 0600);
+  if (!frag_assert(fd >= 0, "failed to open persistent arena file")) {
+    return NULL;
+  }
+  struct stat st;
+  if (!frag_assert(fstat(fd, &st) == 0, "failed to stat persistent arena file")) {
+    close(fd);
+    return NULL;
+  }
+
+  // lay out a new file as [header][buddy tree][data] with the data starting on a page boundary
+  const size_t page_size = vm_page_size();
+  const bool is_new = st.st_size == 0;
+  size_t file_size = (size_t)st.st_size;
+  if (is_new) {
+    const size_t metadata_size = sizeof(persistent_header_t) + buddy_metadata_size(size, PERSISTENT_MIN_BLOCK_SIZE_BYTES);
+    const size_t data_offset = (metadata_size + page_size - 1) & ~(page_size - 1);
+    file_size = data_offset + ((size + page_size - 1) & ~(page_size - 1));
+    if (!frag_assert(ftruncate(fd, (off_t)file_size) == 0, "failed to size persistent arena file")) {
+      close(fd);
+      return NULL;
+    }
+  }
+  else if (!frag_assert(file_size >= sizeof(persistent_header_t), "file is not a persistent arena")) {
+    close(fd);
+    return NULL;
+  }
+
+  // an existing file goes back where it was last time unless told otherwise so its pointers are still valid. the
+  // address is only a hint; if something else is already there we end up elsewhere and need relocating.
+  void* hint = base_address;
+  if (hint == NULL && !is_new) {
+    persistent_header_t peek;
+    if (pread(fd, &peek, sizeof(peek), 0) == (ssize_t)sizeof(peek) && peek.magic == PERSISTENT_MAGIC) {
+      hint = (void*)(uintptr_t)(peek.base - peek.data_offset);
+    }
+  }
+  void* mapping = mmap(hint, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (!frag_assert(mapping != MAP_FAILED, "failed to map persistent arena file")) {
+    return NULL;
+  }
+
+  persistent_header_t* header = (persistent_header_t*)mapping;
+  if (is_new) {
+    header->file_size = file_size;
+    header->data_offset = (uint64_t)(file_size - ((size + page_size - 1) & ~(page_size - 1)));
+    header->data_size = size;
+    header->base = (uint64_t)(uintptr_t)((char*)mapping + header->data_offset);
+    header->root_offset = 0;
+    memset(&header->stats, 0, sizeof(header->stats));
+
+    buddy_t buddy;
+    buddy_init(&buddy, (uint8_t*)(header + 1), size, PERSISTENT_MIN_BLOCK_SIZE_BYTES, true);
+
+    // only mark the file as valid once it's fully set up
+    header->magic = PERSISTENT_MAGIC;
+  }
+  else if (!frag_assert(header->magic == PERSISTENT_MAGIC && header->file_size == file_size, "file is not a persistent arena")) {
+    munmap(mapping, file_size);
+    return NULL;
+  }
+
+  frag_allocator_desc_t desc = {0};
+  desc.name = name;
+  desc.needs_lock = needs_lock;
+  desc.alloc = &persistent_alloc;
+  desc.free = &persistent_free;
+  desc.get_size = &persistent_get_size;
+  desc.shutdown = &persistent_shutdown;
+  desc.query_stats = &persistent_query_stats;
+  desc.query_layout = &persistent_query_layout;
+  desc.impl_size_bytes = sizeof(persistent_allocator_impl_t);
+  frag_allocator_t* allocator = allocator_create(owner, &desc);
+
+  persistent_allocator_impl_t* impl = (persistent_allocator_impl_t*)allocator->impl;
+  impl->header = header;
+  impl->data = (char*)mapping + header->data_offset;
+  buddy_init(&impl->buddy, (uint8_t*)(header + 1), (size_t)header->data_size, PERSISTENT_MIN_BLOCK_SIZE_BYTES, false);
+
+  // where the allocations already in the file were made isn't kept, but they're still tracked so a leak report lists
+  // them by address and size
+  if (!is_new) {
+    buddy_for_each_alloc(&impl->buddy, &track_earlier_alloc, allocator);
+  }
+
+  return allocator;
+}
+
+void* persistent_root(const frag_allocator_t* allocator) {
+  const persistent_allocator_impl_t* impl = (const persistent_allocator_impl_t*)allocator->impl;
+  const uint64_t root_offset = impl->header->root_offset;
+  return root_offset == 0 ? NULL : impl->data + (root_offset - 1);
+}
+
+void persistent_set_root(frag_allocator_t* allocator, void* root) {
+  persistent_allocator_impl_t* impl = (persistent_allocator_impl_t*)allocator->impl;
+  impl->header->root_offset = root == NULL ? 0 : (uint64_t)((char*)root - impl->data) + 1;
+}
+
+ptrdiff_t persistent_relocation_delta(const frag_allocator_t* allocator) {
+  const persistent_allocator_impl_t* impl = (const persistent_allocator_impl_t*)allocator->impl;
+  return (ptrdiff_t)((uintptr_t)impl->data - (uintptr_t)impl->header->base);
+}
+
+void persistent_relocate(frag_allocator_t* allocator, frag_persistent_relocate_func_t func, void* user_data) {
+  persistent_allocator_impl_t* impl = (persistent_allocator_impl_t*)allocator->impl;
+  const ptrdiff_t delta = persistent_relocation_delta(allocator);
+  if (delta == 0) {
+    return;
+  }
+  if (func != NULL) {
+    func(allocator, persistent_root(allocator), delta, user_data);
+  }
+  impl->header->base = (uint64_t)(uintptr_t)impl->data;
+}
+
+bool persistent_flush(frag_allocator_t* allocator) {
+  persistent_allocator_impl_t* impl = (persistent_allocator_impl_t*)allocator->impl;
+  return msync(impl->header, (size_t)impl->header->file_size, MS_SYNC) == 0;
+}
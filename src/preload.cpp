@@ -0,0 +1,418 @@
+// Routes every malloc/free/realloc/calloc/posix_memalign (and on ELF platforms the global operator new/delete) in the
+// process through frag. Load it with LD_PRELOAD (or DYLD_INSERT_LIBRARIES on macOS).
+//
+// By default everything goes to the system allocator. To use a different allocator stack, export a
+// frag_preload_configure() function from the executable (see frag_preload.h) and build it with the API it's given.
+// Only the malloc and operator new families are exported from the library, so its copy of frag stays separate from
+// any the executable links itself, and frag's own calls into the C library go straight to the real one. Set
+// FRAG_PRELOAD_REPORT=1 in the environment to print the allocator stats to stderr when the process exits.
+#include <atomic>
+#include <dlfcn.h>
+#include <errno.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+#include "frag.h"
+#include "frag_preload.h"
+#include "internal.h"
+
+// memory handed out before frag is ready (e.g. to the dynamic loader while we look up the real malloc) or from inside it
+#define PRELOAD_BOOTSTRAP_SIZE_BYTES (256 * 1024)
+#define PRELOAD_BOOTSTRAP_HEADER_BYTES 16
+
+enum preload_state_t {
+  PRELOAD_STATE_UNINITIALIZED,
+  PRELOAD_STATE_INITIALIZING,
+  PRELOAD_STATE_READY,
+};
+
+alignas(64) static char s_bootstrap[PRELOAD_BOOTSTRAP_SIZE_BYTES];
+static std::atomic<size_t> s_bootstrap_used(0);
+static std::atomic<int> s_state(PRELOAD_STATE_UNINITIALIZED);
+static frag_allocator_t* s_allocator;
+
+// non-zero while this thread is inside frag itself (e.g. in a callback), where going back into frag could deadlock on
+// an allocator's lock, so allocations come from the bootstrap buffer instead
+static __thread int t_depth __attribute__((tls_model("initial-exec")));
+
+#if defined(__APPLE__)
+// dyld interposing doesn't apply to the image doing the interposing, so in here these are the real functions
+#define PRELOAD_FUNC(name) frag_preload_##name
+#define real_free free
+#define real_calloc calloc
+#define real_posix_memalign posix_memalign
+#define real_malloc_size malloc_size
+#define PRELOAD_INTERPOSE(name)                                                                        \
+  __attribute__((used)) static const struct {                                                           \
+    const void* replacement;                                                                            \
+    const void* original;                                                                               \
+  } s_interpose_##name __attribute__((section("__DATA,__interpose"))) = {(const void*)&frag_preload_##name, \
+                                                                        (const void*)&name};
+#else
+// on ELF platforms we replace the symbols outright and find the C library's versions with dlsym()
+#define PRELOAD_FUNC(name) name
+static void (*real_free)(void* ptr);
+static void* (*real_calloc)(size_t count, size_t size);
+static int (*real_posix_memalign)(void** ptr, size_t alignment, size_t size);
+static size_t (*real_malloc_usable_size)(void* ptr);
+
+static size_t real_malloc_size(const void* ptr) {
+  return real_malloc_usable_size((void*)ptr);
+}
+#endif
+
+struct preload_scope_t {
+  preload_scope_t() {
+    ++t_depth;
+  }
+  ~preload_scope_t() {
+    --t_depth;
+  }
+};
+
+static void* bootstrap_alloc(size_t size, size_t alignment) {
+  if (alignment < PRELOAD_BOOTSTRAP_HEADER_BYTES) {
+    alignment = PRELOAD_BOOTSTRAP_HEADER_BYTES;
+  }
+  size_t used = s_bootstrap_used.load();
+  char* ptr;
+  size_t new_used;
+  do {
+    ptr = (char*)align_up_with_offset_ptr(s_bootstrap + used, alignment, PRELOAD_BOOTSTRAP_HEADER_BYTES);
+    new_used = (size_t)(ptr - s_bootstrap) + size;
+    if (new_used > PRELOAD_BOOTSTRAP_SIZE_BYTES) {
+      return NULL;
+    }
+  } while (!s_bootstrap_used.compare_exchange_weak(used, new_used));
+
+  *((size_t*)ptr - 1) = size;
+  return ptr;
+}
+
+static bool is_bootstrap(const void* ptr) {
+  return (const char*)ptr >= s_bootstrap && (const char*)ptr < s_bootstrap + PRELOAD_BOOTSTRAP_SIZE_BYTES;
+}
+
+static size_t bootstrap_get_size(const void* ptr) {
+  return *((const size_t*)ptr - 1);
+}
+
+static void ignore_out_of_memory(const frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func) {
+  // malloc reports this by returning NULL
+}
+
+// what a frag_preload_configure() hook gets to build its allocators with
+static const frag_preload_api_t s_api = {
+  &frag_alloc_ex,
+  &frag_free_ex,
+  &frag_system_allocator,
+  &frag_allocator_create,
+  &frag_allocator_destroy,
+  &frag_allocator_set_budget,
+  &frag_allocator_set_pressure_handler,
+  &frag_allocator_trim,
+  &frag_allocator_stats,
+  &frag_fixed_stack_allocator_create,
+  &frag_frame_allocator_create,
+  &frag_vm_stack_allocator_create,
+  &frag_buddy_allocator_create,
+  &frag_guarded_allocator_create,
+  &frag_group_allocator_create,
+  &frag_object_cache_allocator_create,
+};
+
+static void print_report() {
+  preload_scope_t scope;
+  frag_allocator_stats_t stats;
+  frag_allocator_stats(s_allocator, &stats);
+  fprintf(stderr, "frag_preload: bytes=%zu count=%zu bytes_peak=%zu count_peak=%zu\n", stats.bytes, stats.count, stats.bytes_peak, stats.count_peak);
+}
+
+static void preload_init() {
+  int state = PRELOAD_STATE_UNINITIALIZED;
+  if (!s_state.compare_exchange_strong(state, PRELOAD_STATE_INITIALIZING)) {
+    return;
+  }
+
+#if !defined(__APPLE__)
+  // dlsym() may allocate, which is served from the bootstrap buffer until we're ready
+  real_free = (void (*)(void*))dlsym(RTLD_NEXT, "free");
+  real_calloc = (void* (*)(size_t, size_t))dlsym(RTLD_NEXT, "calloc");
+  real_posix_memalign = (int (*)(void**, size_t, size_t))dlsym(RTLD_NEXT, "posix_memalign");
+  real_malloc_usable_size = (size_t (*)(void*))dlsym(RTLD_NEXT, "malloc_usable_size");
+#endif
+
+  // frag's own memory comes straight from the C library rather than back through here
+  system_libc_t libc;
+  libc.posix_memalign = real_posix_memalign;
+  libc.calloc = real_calloc;
+  libc.free = real_free;
+  libc.usable_size = &real_malloc_size;
+  system_set_libc(&libc);
+
+  frag_config_t config;
+  frag_config_init(&config);
+  config.report_out_of_memory = &ignore_out_of_memory;
+  frag_lib_init(&config);
+
+  // the hook runs as application code, so what it mallocs itself comes from the bootstrap buffer and can be freed
+  // later without frag ever seeing it
+  frag_allocator_t* system = frag_system_allocator();
+  s_allocator = system;
+  frag_preload_configure_func_t configure = (frag_preload_configure_func_t)dlsym(RTLD_DEFAULT, "frag_preload_configure");
+  if (configure != NULL) {
+    frag_allocator_t* allocator = configure(system, &s_api);
+    if (allocator != NULL) {
+      s_allocator = allocator;
+    }
+  }
+
+  const char* report = getenv("FRAG_PRELOAD_REPORT");
+  if (report != NULL && report[0] != 0 && report[0] != '0') {
+    atexit(&print_report);
+  }
+
+  s_state.store(PRELOAD_STATE_READY);
+}
+
+__attribute__((constructor)) static void preload_constructor() {
+  preload_init();
+}
+
+// Returns true if the call should go through frag, otherwise the caller should use the bootstrap buffer.
+static bool use_frag() {
+  if (t_depth > 0) {
+    return false;
+  }
+  if (s_state.load(std::memory_order_acquire) != PRELOAD_STATE_READY) {
+    preload_init();
+    return s_state.load(std::memory_order_acquire) == PRELOAD_STATE_READY && t_depth == 0;
+  }
+  return true;
+}
+
+static void* preload_alloc(size_t size, size_t alignment) {
+  void* ptr;
+  if (use_frag()) {
+    preload_scope_t scope;
+    ptr = frag_alloc_ex(s_allocator, size, alignment, __FILE__, __LINE__, __func__);
+  }
+  else {
+    ptr = bootstrap_alloc(size, alignment);
+  }
+  if (ptr == NULL) {
+    errno = ENOMEM;
+  }
+  return ptr;
+}
+
+static void preload_free(void* ptr) {
+  if (ptr == NULL || is_bootstrap(ptr)) {
+    return;
+  }
+  // everything else came from frag, but from inside frag it's leaked rather than risk taking a lock that's held
+  if (use_frag()) {
+    preload_scope_t scope;
+    frag_free_ex(s_allocator, ptr, __FILE__, __LINE__, __func__);
+  }
+}
+
+extern "C" {
+
+void* PRELOAD_FUNC(malloc)(size_t size) {
+  return preload_alloc(size, 0);
+}
+
+void PRELOAD_FUNC(free)(void* ptr) {
+  preload_free(ptr);
+}
+
+void* PRELOAD_FUNC(calloc)(size_t count, size_t size) {
+  const size_t total = count * size;
+  if (size != 0 && total / size != count) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  if (use_frag()) {
+    preload_scope_t scope;
+    void* ptr = frag_alloc_zero_ex(s_allocator, total, 0, __FILE__, __LINE__, __func__);
+    if (ptr == NULL) {
+      errno = ENOMEM;
+    }
+    return ptr;
+  }
+
+  // the bootstrap buffer is static so it's already zero
+  return preload_alloc(total, 0);
+}
+
+void* PRELOAD_FUNC(realloc)(void* ptr, size_t size) {
+  if (ptr != NULL && is_bootstrap(ptr)) {
+    // bootstrap memory is never reused, so just move the data somewhere else
+    void* ptr_new = preload_alloc(size, 0);
+    if (ptr_new != NULL) {
+      const size_t size_old = bootstrap_get_size(ptr);
+      memcpy(ptr_new, ptr, size < size_old ? size : size_old);
+    }
+    return ptr_new;
+  }
+  if (use_frag()) {
+    if (size == 0) {
+      preload_free(ptr);
+      return NULL;
+    }
+    // unlike frag_realloc(), the original block has to survive a failed allocation
+    preload_scope_t scope;
+    void* ptr_new = frag_alloc_ex(s_allocator, size, 0, __FILE__, __LINE__, __func__);
+    if (ptr_new == NULL) {
+      errno = ENOMEM;
+      return NULL;
+    }
+    if (ptr != NULL) {
+      const size_t size_old = allocator_get_size(s_allocator, ptr);
+      memcpy(ptr_new, ptr, size < size_old ? size : size_old);
+      frag_free_ex(s_allocator, ptr, __FILE__, __LINE__, __func__);
+    }
+    return ptr_new;
+  }
+  if (ptr == NULL) {
+    return preload_alloc(size, 0);
+  }
+
+  // frag memory can't be resized from inside frag (see preload_free())
+  errno = ENOMEM;
+  return NULL;
+}
+
+int PRELOAD_FUNC(posix_memalign)(void** ptr, size_t alignment, size_t size) {
+  if (!is_pow_2(alignment) || alignment % sizeof(void*) != 0) {
+    return EINVAL;
+  }
+  void* result = preload_alloc(size, alignment);
+  if (result == NULL) {
+    return ENOMEM;
+  }
+  *ptr = result;
+  return 0;
+}
+
+#if defined(__APPLE__)
+PRELOAD_INTERPOSE(malloc)
+PRELOAD_INTERPOSE(free)
+PRELOAD_INTERPOSE(calloc)
+PRELOAD_INTERPOSE(realloc)
+PRELOAD_INTERPOSE(posix_memalign)
+#else
+void* aligned_alloc(size_t alignment, size_t size) {
+  if (!is_pow_2(alignment)) {
+    errno = EINVAL;
+    return NULL;
+  }
+  return preload_alloc(size, alignment);
+}
+
+void* memalign(size_t alignment, size_t size) {
+  return aligned_alloc(alignment, size);
+}
+
+void* valloc(size_t size) {
+  return preload_alloc(size, vm_page_size());
+}
+
+size_t malloc_usable_size(void* ptr) {
+  if (ptr == NULL) {
+    return 0;
+  }
+  if (is_bootstrap(ptr)) {
+    return bootstrap_get_size(ptr);
+  }
+  if (use_frag()) {
+    preload_scope_t scope;
+    return allocator_get_size(s_allocator, ptr);
+  }
+  return 0;
+}
+#endif
+
+} // extern "C"
+
+#if !defined(__APPLE__)
+// on macOS the C++ runtime's operator new ends up in malloc anyway, so this is only needed where we replace symbols
+static void* preload_new(size_t size, size_t alignment) {
+  void* ptr = preload_alloc(size, alignment);
+  if (ptr == NULL) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new(size_t size) {
+  return preload_new(size, 0);
+}
+
+void* operator new[](size_t size) {
+  return preload_new(size, 0);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return preload_alloc(size, 0);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return preload_alloc(size, 0);
+}
+
+void operator delete(void* ptr) noexcept {
+  preload_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  preload_free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  preload_free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  preload_free(ptr);
+}
+
+void operator delete(void* ptr, size_t size) noexcept {
+  preload_free(ptr);
+}
+
+void operator delete[](void* ptr, size_t size) noexcept {
+  preload_free(ptr);
+}
+
+#if defined(__cpp_aligned_new)
+void* operator new(size_t size, std::align_val_t alignment) {
+  return preload_new(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return preload_new(size, (size_t)alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t alignment) noexcept {
+  preload_free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept {
+  preload_free(ptr);
+}
+
+void operator delete(void* ptr, size_t size, std::align_val_t alignment) noexcept {
+  preload_free(ptr);
+}
+
+void operator delete[](void* ptr, size_t size, std::align_val_t alignment) noexcept {
+  preload_free(ptr);
+}
+#endif
+#endif
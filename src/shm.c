@@ -0,0 +1,280 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "internal.h"
+
+// "fragshm" followed by a layout version
+#define SHM_MAGIC 0x6672616773686d01ull
+#define SHM_MIN_BLOCK_SIZE_BYTES 64
+#define SHM_NAME_MAX_LENGTH 256
+
+// whether the lock can recover from a process dying while holding it (glibc has robust mutexes, macOS doesn't)
+#if defined(__linux__) && defined(__GLIBC__)
+#define SHM_ROBUST_MUTEX 1
+#else
+#define SHM_ROBUST_MUTEX 0
+#endif
+
+// Lives at the start of the segment. Everything in here is shared between processes so it must not hold pointers.
+typedef struct shm_header_t {
+  uint64_t magic;
+  uint64_t segment_size;
+  uint64_t data_offset;
+  uint64_t data_size;
+  uint64_t attach_count;
+  pthread_mutex_t mutex;
+  frag_allocator_stats_t stats;
+  // followed by the buddy tree and then the data
+} shm_header_t;
+
+typedef struct shm_allocator_impl_t {
+  shm_header_t* header;
+  char* data;
+  buddy_t buddy;
+  bool is_creator;
+  char shm_name[SHM_NAME_MAX_LENGTH];
+} shm_allocator_impl_t;
+
+#if SHM_ROBUST_MUTEX
+// A process died while holding the lock, maybe part way through updating the tree or the stats. The leaves and the
+// allocated nodes are each written in one go, so the rest of the tree and the stats can be rebuilt from them.
+static void shm_recover(shm_header_t* header) {
+  buddy_t buddy;
+  buddy_init(&buddy, (uint8_t*)(header + 1), (size_t)header->data_size, SHM_MIN_BLOCK_SIZE_BYTES, false);
+  buddy_repair(&buddy);
+
+  frag_allocator_layout_t layout;
+  memset(&layout, 0, sizeof(layout));
+  buddy_query_layout(&buddy, &layout);
+  header->stats.count = 0;
+  header->stats.bytes = 0;
+  for (unsigned int index = 0; index < layout.size_class_count; ++index) {
+    header->stats.count += layout.size_classes[index].used_count;
+    header->stats.bytes += layout.size_classes[index].used_count * layout.size_classes[index].block_size;
+  }
+  if (header->stats.count > header->stats.count_peak) {
+    header->stats.count_peak = header->stats.count;
+  }
+  if (header->stats.bytes > header->stats.bytes_peak) {
+    header->stats.bytes_peak = header->stats.bytes;
+  }
+}
+#endif
+
+static void shm_lock(shm_header_t* header) {
+  const int status = pthread_mutex_lock(&header->mutex);
+#if SHM_ROBUST_MUTEX
+  if (status == EOWNERDEAD) {
+    shm_recover(header);
+    pthread_mutex_consistent(&header->mutex);
+    return;
+  }
+#endif
+  frag_assert(status == 0, "failed to lock shared memory segment");
+}
+
+static void shm_unlock(shm_header_t* header) {
+  pthread_mutex_unlock(&header->mutex);
+}
+
+static size_t shm_get_size(const frag_allocator_t* allocator, void* ptr) {
+  const shm_allocator_impl_t* impl = (const shm_allocator_impl_t*)allocator->impl;
+  shm_lock(impl->header);
+  const size_t size = buddy_block_size(&impl->buddy, (size_t)((char*)ptr - impl->data));
+  shm_unlock(impl->header);
+  return size;
+}
+
+static void* shm_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  shm_allocator_impl_t* impl = (shm_allocator_impl_t*)allocator->impl;
+  frag_assert(is_pow_2(alignment), "alignment is not a power of 2");
+  frag_assert(alignment <= vm_page_size(), "alignment is larger than a page");
+
+  shm_header_t* header = impl->header;
+  shm_lock(header);
+  size_t offset;
+  void* ptr = NULL;
+  if (buddy_alloc(&impl->buddy, size, alignment, &offset, size_allocated)) {
+    ptr = impl->data + offset;
+    ++header->stats.count;
+    if (header->stats.count > header->stats.count_peak) {
+      header->stats.count_peak = header->stats.count;
+    }
+    header->stats.bytes += *size_allocated;
+    if (header->stats.bytes > header->stats.bytes_peak) {
+      header->stats.bytes_peak = header->stats.bytes;
+    }
+  }
+  else {
+    *size_allocated = 0;
+  }
+  shm_unlock(header);
+
+  return ptr;
+}
+
+static void shm_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
+  shm_allocator_impl_t* impl = (shm_allocator_impl_t*)allocator->impl;
+  shm_header_t* header = impl->header;
+  shm_lock(header);
+  const size_t size = buddy_free(&impl->buddy, (size_t)((char*)ptr - impl->data));
+  if (size > 0) {
+    --header->stats.count;
+    header->stats.bytes -= size;
+  }
+  shm_unlock(header);
+}
+
+static void shm_query_stats(const frag_allocator_t* allocator, frag_allocator_stats_t* stats) {
+  const shm_allocator_impl_t* impl = (const shm_allocator_impl_t*)allocator->impl;
+  shm_lock(impl->header);
+  *stats = impl->header->stats;
+  shm_unlock(impl->header);
+}
+
+static void shm_query_layout(const frag_allocator_t* allocator, frag_allocator_layout_t* layout) {
+  const shm_allocator_impl_t* impl = (const shm_allocator_impl_t*)allocator->impl;
+  shm_lock(impl->header);
+  buddy_query_layout(&impl->buddy, layout);
+  shm_unlock(impl->header);
+}
+
+static void shm_shutdown(frag_allocator_t* allocator) {
+  shm_allocator_impl_t* impl = (shm_allocator_impl_t*)allocator->impl;
+  shm_header_t* header = impl->header;
+
+  // allocations are owned by the segment rather than by any one process so they only leak once everyone has gone
+  shm_lock(header);
+  const bool is_last = header->attach_count == 1;
+  const bool has_leaks = header->stats.count != 0;
+  --header->attach_count;
+  shm_unlock(header);
+  if (is_last && has_leaks) {
+    allocator_report_leak(allocator);
+  }
+
+  if (impl->is_creator) {
+    shm_unlink(impl->shm_name);
+  }
+  munmap(header, header->segment_size);
+}
+
+static frag_allocator_t* shm_allocator_create(frag_allocator_t* owner, const char* name, bool needs_lock, const char* shm_name, shm_header_t* header, bool is_creator) {
+  frag_allocator_desc_t desc = {0};
+  desc.name = name;
+  desc.needs_lock = needs_lock;
+  desc.alloc = &shm_alloc;
+  desc.free = &shm_free;
+  desc.get_size = &shm_get_size;
+  desc.shutdown = &shm_shutdown;
+  desc.query_stats = &shm_query_stats;
+  desc.query_layout = &shm_query_layout;
+  desc.impl_size_bytes = sizeof(shm_allocator_impl_t);
+  frag_allocator_t* allocator = allocator_create(owner, &desc);
+
+  shm_allocator_impl_t* impl = (shm_allocator_impl_t*)allocator->impl;
+  impl->header = header;
+  impl->data = (char*)header + header->data_offset;
+  impl->is_creator = is_creator;
+  strncpy(impl->shm_name, shm_name, SHM_NAME_MAX_LENGTH - 1);
+  impl->shm_name[SHM_NAME_MAX_LENGTH - 1] = 0;
+  buddy_init(&impl->buddy, (uint8_t*)(header + 1), (size_t)header->data_size, SHM_MIN_BLOCK_SIZE_BYTES, false);
+
+  return allocator;
+}
+
+frag_allocator_t* shm_create(frag_allocator_t* owner, const char* name, bool needs_lock, const char* shm_name, size_t size) {
+  if (!frag_assert(strlen(shm_name) < SHM_NAME_MAX_LENGTH, "shared memory name is too long")) {
+    return NULL;
+  }
+
+  // lay out the segment as [header][buddy tree][data] with the data starting on a page boundary
+  const size_t page_size = vm_page_size();
+  const size_t metadata_size = sizeof(shm_header_t) + buddy_metadata_size(size, SHM_MIN_BLOCK_SIZE_BYTES);
+  const size_t data_offset = (metadata_size + page_size - 1) & ~(page_size - 1);
+  const size_t segment_size = data_offset + ((size + page_size - 1) & ~(page_size - 1));
+
+  const int fd = shm_open(shm_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (!frag_assert(fd >= 0, "failed to create shared memory segment")) {
+    return NULL;
+  }
+  void* segment = MAP_FAILED;
+  if (ftruncate(fd, (off_t)segment_size) == 0) {
+    segment = mmap(NULL, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (!frag_assert(segment != MAP_FAILED, "failed to map shared memory segment")) {
+    shm_unlink(shm_name);
+    return NULL;
+  }
+
+  shm_header_t* header = (shm_header_t*)segment;
+  header->segment_size = segment_size;
+  header->data_offset = data_offset;
+  header->data_size = size;
+  header->attach_count = 1;
+  memset(&header->stats, 0, sizeof(header->stats));
+
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+#if SHM_ROBUST_MUTEX
+  pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+#endif
+  pthread_mutex_init(&header->mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+
+  buddy_t buddy;
+  buddy_init(&buddy, (uint8_t*)(header + 1), size, SHM_MIN_BLOCK_SIZE_BYTES, true);
+
+  // publish the segment only once it is fully set up
+  __atomic_store_n(&header->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+
+  return shm_allocator_create(owner, name, needs_lock, shm_name, header, true);
+}
+
+frag_allocator_t* shm_attach(frag_allocator_t* owner, const char* name, bool needs_lock, const char* shm_name) {
+  if (!frag_assert(strlen(shm_name) < SHM_NAME_MAX_LENGTH, "shared memory name is too long")) {
+    return NULL;
+  }
+
+  const int fd = shm_open(shm_name, O_RDWR, 0600);
+  if (!frag_assert(fd >= 0, "failed to open shared memory segment")) {
+    return NULL;
+  }
+  struct stat st;
+  void* segment = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(shm_header_t)) {
+    segment = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (!frag_assert(segment != MAP_FAILED, "failed to map shared memory segment")) {
+    return NULL;
+  }
+
+  shm_header_t* header = (shm_header_t*)segment;
+  if (!frag_assert(__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == SHM_MAGIC, "shared memory segment is not initialized")) {
+    munmap(segment, (size_t)st.st_size);
+    return NULL;
+  }
+
+  shm_lock(header);
+  ++header->attach_count;
+  shm_unlock(header);
+
+  return shm_allocator_create(owner, name, needs_lock, shm_name, header, false);
+}
+
+size_t shm_ptr_to_offset(const frag_allocator_t* allocator, const void* ptr) {
+  const shm_allocator_impl_t* impl = (const shm_allocator_impl_t*)allocator->impl;
+  return (size_t)((const char*)ptr - impl->data);
+}
+
+void* shm_offset_to_ptr(const frag_allocator_t* allocator, size_t offset) {
+  const shm_allocator_impl_t* impl = (const shm_allocator_impl_t*)allocator->impl;
+  return impl->data + offset;
+}
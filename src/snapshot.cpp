@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <mutex>
+#include <string.h>
+#include "frag.h"
+#include "internal.h"
+
+struct snapshot_entry_t {
+  // only used to tell allocations in different allocators apart; it may be gone by the time the snapshot is used
+  const frag_allocator_t* allocator;
+  const void* ptr;
+  size_t size;
+  const char* file;
+  const char* func;
+  int line;
+  unsigned int name_offset;
+};
+
+struct frag_snapshot_t {
+  snapshot_entry_t* entries;
+  size_t count;
+  size_t capacity;
+  size_t bytes;
+
+  // copies of the allocator names, since the allocators may be destroyed before the snapshot is used
+  char* names;
+  size_t names_size;
+  size_t names_capacity;
+};
+
+// snapshots are frag's own bookkeeping, so they live with the tracking tables they're taking a copy of
+static void* snapshot_alloc(size_t size) {
+  return frag_alloc(frag_metadata_allocator(), size);
+}
+
+static void snapshot_free(void* ptr) {
+  frag_free(frag_metadata_allocator(), ptr);
+}
+
+static bool snapshot_reserve(void** buf, size_t* capacity, size_t used, size_t needed, size_t element_size) {
+  if (needed <= *capacity) {
+    return true;
+  }
+  size_t new_capacity = *capacity > 0 ? *capacity * 2 : 256;
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+  void* new_buf = snapshot_alloc(new_capacity * element_size);
+  if (new_buf == NULL) {
+    return false;
+  }
+  if (*buf != NULL) {
+    memcpy(new_buf, *buf, used * element_size);
+    snapshot_free(*buf);
+  }
+  *buf = new_buf;
+  *capacity = new_capacity;
+  return true;
+}
+
+static void snapshot_add_allocator(frag_allocator_t* allocator, void* user_data) {
+  frag_snapshot_t* snapshot = (frag_snapshot_t*)user_data;
+
+  // protect access to this allocator if necessary
+  std::mutex* mutex = (std::mutex*)allocator->mutex;
+  std::unique_lock<std::mutex> lock;
+  if (mutex != NULL) {
+    lock = std::unique_lock<std::mutex>(*mutex);
+  }
+
+  const frag_allocator_debug_t* debug = &allocator->debug;
+  if (debug->count == 0) {
+    return;
+  }
+  const size_t name_size = strlen(allocator->name) + 1;
+  if (!snapshot_reserve((void**)&snapshot->entries, &snapshot->capacity, snapshot->count, snapshot->count + debug->count, sizeof(snapshot_entry_t)) ||
+      !snapshot_reserve((void**)&snapshot->names, &snapshot->names_capacity, snapshot->names_size, snapshot->names_size + name_size, 1)) {
+    return;
+  }
+
+  const unsigned int name_offset = (unsigned int)snapshot->names_size;
+  memcpy(snapshot->names + name_offset, allocator->name, name_size);
+  snapshot->names_size += name_size;
+
+  for (unsigned int index = 0; index < debug->count; ++index) {
+    const frag_debug_alloc_info_t* alloc = debug->allocs + index;
+    snapshot_entry_t* entry = snapshot->entries + snapshot->count++;
+    entry->allocator = allocator;
+    entry->ptr = alloc->ptr;
+    entry->size = alloc->size;
+    entry->file = alloc->file;
+    entry->func = alloc->func;
+    entry->line = alloc->line;
+    entry->name_offset = name_offset;
+    snapshot->bytes += alloc->size;
+  }
+}
+
+static bool entry_less(const snapshot_entry_t& lhs, const snapshot_entry_t& rhs) {
+  if (lhs.allocator != rhs.allocator) {
+    return lhs.allocator < rhs.allocator;
+  }
+  return lhs.ptr < rhs.ptr;
+}
+
+static bool entry_same_alloc(const snapshot_entry_t& lhs, const snapshot_entry_t& rhs) {
+  return lhs.allocator == rhs.allocator && lhs.ptr == rhs.ptr && lhs.line == rhs.line && lhs.file == rhs.file;
+}
+
+// orders new allocations so that everything from the same site ends up next to each other
+static bool entry_site_less(const snapshot_entry_t* lhs, const snapshot_entry_t* rhs) {
+  if (lhs->name_offset != rhs->name_offset) {
+    return lhs->name_offset < rhs->name_offset;
+  }
+  if (lhs->file != rhs->file) {
+    return lhs->file < rhs->file;
+  }
+  if (lhs->line != rhs->line) {
+    return lhs->line < rhs->line;
+  }
+  return lhs->func < rhs->func;
+}
+
+static bool entry_same_site(const snapshot_entry_t* lhs, const snapshot_entry_t* rhs) {
+  return lhs->name_offset == rhs->name_offset && lhs->file == rhs->file && lhs->line == rhs->line && lhs->func == rhs->func;
+}
+
+frag_snapshot_t* frag_snapshot_take() {
+  frag_snapshot_t* snapshot = (frag_snapshot_t*)snapshot_alloc(sizeof(frag_snapshot_t));
+  if (snapshot == NULL) {
+    return NULL;
+  }
+  memset(snapshot, 0, sizeof(*snapshot));
+
+  registry_for_each(&snapshot_add_allocator, snapshot);
+  std::sort(snapshot->entries, snapshot->entries + snapshot->count, &entry_less);
+  return snapshot;
+}
+
+void frag_snapshot_free(frag_snapshot_t* snapshot) {
+  if (snapshot == NULL) {
+    return;
+  }
+  snapshot_free(snapshot->entries);
+  snapshot_free(snapshot->names);
+  snapshot_free(snapshot);
+}
+
+void frag_snapshot_totals(const frag_snapshot_t* snapshot, size_t* count, size_t* bytes) {
+  frag_assert(snapshot != NULL, "snapshot is null");
+  if (count != NULL) {
+    *count = snapshot->count;
+  }
+  if (bytes != NULL) {
+    *bytes = snapshot->bytes;
+  }
+}
+
+frag_snapshot_diff_t* frag_snapshot_diff(const frag_snapshot_t* before, const frag_snapshot_t* after) {
+  if (!frag_assert(before != NULL && after != NULL, "snapshot is null")) {
+    return NULL;
+  }
+
+  // both snapshots are sorted so the new allocations fall out of a single merge
+  const snapshot_entry_t** added = (const snapshot_entry_t**)snapshot_alloc((after->count + 1) * sizeof(snapshot_entry_t*));
+  if (added == NULL) {
+    return NULL;
+  }
+  size_t added_count = 0;
+  size_t before_index = 0;
+  for (size_t after_index = 0; after_index < after->count; ++after_index) {
+    const snapshot_entry_t& entry = after->entries[after_index];
+    while (before_index < before->count && entry_less(before->entries[before_index], entry)) {
+      ++before_index;
+    }
+    if (before_index == before->count || !entry_same_alloc(before->entries[before_index], entry)) {
+      added[added_count++] = &entry;
+    }
+  }
+
+  // group them by site
+  std::sort(added, added + added_count, &entry_site_less);
+  size_t site_count = 0;
+  for (size_t index = 0; index < added_count; ++index) {
+    if (index == 0 || !entry_same_site(added[index - 1], added[index])) {
+      ++site_count;
+    }
+  }
+
+  // the diff, its sites and its copy of the names all live in one block
+  const size_t sites_offset = (sizeof(frag_snapshot_diff_t) + 15) & ~(size_t)15;
+  const size_t names_offset = sites_offset + site_count * sizeof(frag_snapshot_site_t);
+  char* block = (char*)snapshot_alloc(names_offset + after->names_size);
+  if (block == NULL) {
+    snapshot_free(added);
+    return NULL;
+  }
+  frag_snapshot_diff_t* diff = (frag_snapshot_diff_t*)block;
+  frag_snapshot_site_t* sites = (frag_snapshot_site_t*)(block + sites_offset);
+  char* names = block + names_offset;
+  if (after->names_size > 0) {
+    memcpy(names, after->names, after->names_size);
+  }
+
+  diff->sites = sites;
+  diff->site_count = (unsigned int)site_count;
+  diff->count = added_count;
+  diff->bytes = 0;
+  frag_snapshot_site_t* site = sites - 1;
+  for (size_t index = 0; index < added_count; ++index) {
+    const snapshot_entry_t* entry = added[index];
+    if (index == 0 || !entry_same_site(added[index - 1], entry)) {
+      ++site;
+      site->allocator_name = names + entry->name_offset;
+      site->file = entry->file;
+      site->func = entry->func;
+      site->line = entry->line;
+      site->count = 0;
+      site->bytes = 0;
+    }
+    ++site->count;
+    site->bytes += entry->size;
+    diff->bytes += entry->size;
+  }
+  snapshot_free(added);
+
+  std::sort(sites, sites + site_count, [](const frag_snapshot_site_t& lhs, const frag_snapshot_site_t& rhs) {
+    return lhs.bytes > rhs.bytes;
+  });
+  return diff;
+}
+
+void frag_snapshot_diff_free(frag_snapshot_diff_t* diff) {
+  snapshot_free(diff);
+}
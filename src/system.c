@@ -1,6 +1,22 @@
 #include <malloc/malloc.h>
+#include <stdint.h>
+#include <string.h>
 #include "internal.h"
 
+// the alignment malloc and calloc are guaranteed to return
+#define SYSTEM_MALLOC_ALIGNMENT 16
+
+static size_t libc_malloc_size(const void* ptr) {
+  return malloc_size(ptr);
+}
+
+// the C library functions the system allocator calls (see system_set_libc())
+static system_libc_t s_libc = {&posix_memalign, &calloc, &free, &libc_malloc_size};
+
+void system_set_libc(const system_libc_t* libc) {
+  s_libc = *libc;
+}
+
 static void* system_alloc(frag_allocator_t* allocator,
                           size_t size,
                           size_t alignment,
@@ -9,9 +25,37 @@ static void* system_alloc(frag_allocator_t* allocator,
                           const char* func,
                           size_t* size_allocated) {
   void* ptr = NULL;
-  int status = posix_memalign(&ptr, alignment, size);
+  int status = s_libc.posix_memalign(&ptr, alignment, size);
   if (status == 0) {
-    *size_allocated = malloc_size(ptr);
+    *size_allocated = s_libc.usable_size(ptr);
+  }
+  else {
+    *size_allocated = 0;
+  }
+  return ptr;
+}
+
+static void* system_alloc_zero(frag_allocator_t* allocator,
+                               size_t size,
+                               size_t alignment,
+                               const char* file,
+                               int line,
+                               const char* func,
+                               size_t* size_allocated) {
+  // calloc knows when it is handing out fresh pages from the OS and can skip clearing them, but it can't do alignment
+  void* ptr = NULL;
+  if (alignment <= SYSTEM_MALLOC_ALIGNMENT) {
+    ptr = s_libc.calloc(1, size);
+  }
+  else if (s_libc.posix_memalign(&ptr, alignment, size) == 0) {
+    memset(ptr, 0, size);
+  }
+  else {
+    ptr = NULL;
+  }
+
+  if (ptr != NULL) {
+    *size_allocated = s_libc.usable_size(ptr);
   }
   else {
     *size_allocated = 0;
@@ -20,16 +64,23 @@ static void* system_alloc(frag_allocator_t* allocator,
 }
 
 static void system_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
-  free(ptr);
+  s_libc.free(ptr);
 }
 
 static size_t system_get_size(const frag_allocator_t* allocator, void* ptr) {
-  return malloc_size(ptr);
+  return s_libc.usable_size(ptr);
 }
 
 static void system_shutdown(frag_allocator_t* allocator) {
 }
 
+static size_t system_trim(frag_allocator_t* allocator, size_t keep_bytes, size_t max_release_bytes) {
+  // the malloc zones don't let us hold back a specific amount so `keep_bytes` is ignored here (a goal of 0 means release
+  // as much as possible)
+  const size_t goal = max_release_bytes == SIZE_MAX ? 0 : max_release_bytes;
+  return malloc_zone_pressure_relief(NULL, goal);
+}
+
 frag_allocator_t* system_create(void* buffer, size_t buffer_size_bytes, const char* name, bool needs_lock) {
   frag_allocator_desc_t desc = {0};
   desc.name = name;
@@ -38,6 +89,8 @@ frag_allocator_t* system_create(void* buffer, size_t buffer_size_bytes, const ch
   desc.free = &system_free;
   desc.get_size = &system_get_size;
   desc.shutdown = &system_shutdown;
+  desc.trim = &system_trim;
+  desc.alloc_zero = &system_alloc_zero;
   desc.impl_size_bytes = 0;
   frag_allocator_t* allocator = allocator_init(buffer, buffer_size_bytes, NULL, &desc);
 
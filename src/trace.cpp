@@ -0,0 +1,332 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <inttypes.h>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include "frag.h"
+#include "internal.h"
+
+// events each thread can buffer before the writer gets to them (must be a power of 2). anything past this is dropped.
+#define TRACE_RING_CAPACITY 32768
+
+// how often the writer drains the thread buffers
+#define TRACE_DRAIN_INTERVAL_MSEC 2
+
+enum trace_event_type_t : uint8_t {
+  TRACE_EVENT_ALLOC,
+  TRACE_EVENT_FREE,
+  TRACE_EVENT_RESET,
+};
+
+struct trace_event_t {
+  uint64_t time_nsec;
+  const char* allocator_name;
+  const void* ptr;
+  size_t size;
+  trace_event_type_t type;
+};
+
+// A single producer (the owning thread), single consumer (whoever holds s_writer_mutex) queue of events.
+struct trace_ring_t {
+  std::atomic<uint64_t> head;
+  std::atomic<uint64_t> tail;
+  std::atomic<uint64_t> dropped;
+  std::atomic<bool> retired;
+  uint64_t thread_id;
+  trace_ring_t* next;
+  trace_event_t events[TRACE_RING_CAPACITY];
+};
+
+// retires the thread's ring when the thread exits so the writer can free it once it's drained
+struct trace_thread_guard_t {
+  ~trace_thread_guard_t();
+
+  trace_ring_t* ring = nullptr;
+};
+
+static std::atomic<bool> s_enabled(false);
+static std::chrono::steady_clock::time_point s_start_time;
+
+// the list of rings is only added to by the owning threads and only removed from by the writer
+static std::mutex s_rings_mutex;
+static trace_ring_t* s_rings;
+static std::atomic<uint64_t> s_next_thread_id(1);
+
+// events dropped by threads whose rings have since been freed
+static uint64_t s_dropped;
+
+// protects the output file and draining the rings
+static std::mutex s_writer_mutex;
+static FILE* s_file;
+static bool s_first_event;
+
+static std::mutex s_thread_mutex;
+static std::condition_variable s_thread_cond;
+static std::thread s_thread;
+static bool s_thread_stop;
+static unsigned int s_counter_interval_msec;
+
+static thread_local trace_thread_guard_t t_thread;
+
+trace_thread_guard_t::~trace_thread_guard_t() {
+  if (ring != nullptr) {
+    ring->retired.store(true, std::memory_order_release);
+    ring = nullptr;
+  }
+}
+
+static size_t ring_size_bytes() {
+  const size_t page_size = vm_page_size();
+  return (sizeof(trace_ring_t) + page_size - 1) & ~(page_size - 1);
+}
+
+static trace_ring_t* ring_create() {
+  // rings come straight from the OS since this is called from inside allocators, including the system one
+  const size_t size = ring_size_bytes();
+  void* mem = vm_reserve(size);
+  if (mem == NULL || !vm_commit(mem, size)) {
+    return nullptr;
+  }
+
+  trace_ring_t* ring = new (mem) trace_ring_t;
+  ring->head.store(0);
+  ring->tail.store(0);
+  ring->dropped.store(0);
+  ring->retired.store(false);
+  ring->thread_id = s_next_thread_id.fetch_add(1);
+
+  std::lock_guard<std::mutex> lock(s_rings_mutex);
+  ring->next = s_rings;
+  s_rings = ring;
+  return ring;
+}
+
+static void record(trace_event_type_t type, const frag_allocator_t* allocator, const void* ptr, size_t size) {
+  if (!s_enabled.load(std::memory_order_acquire)) {
+    return;
+  }
+  trace_ring_t* ring = t_thread.ring;
+  if (ring == nullptr) {
+    ring = t_thread.ring = ring_create();
+    if (ring == nullptr) {
+      return;
+    }
+  }
+
+  const uint64_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->tail.load(std::memory_order_acquire) >= TRACE_RING_CAPACITY) {
+    ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  trace_event_t* event = ring->events + (head & (TRACE_RING_CAPACITY - 1));
+  event->time_nsec = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_start_time).count();
+  event->allocator_name = allocator->name;
+  event->ptr = ptr;
+  event->size = size;
+  event->type = type;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+void trace_alloc(const frag_allocator_t* allocator, const void* ptr, size_t size) {
+  record(TRACE_EVENT_ALLOC, allocator, ptr, size);
+}
+
+void trace_free(const frag_allocator_t* allocator, const void* ptr, size_t size) {
+  record(TRACE_EVENT_FREE, allocator, ptr, size);
+}
+
+void trace_reset(const frag_allocator_t* allocator, const void* ptr, size_t size) {
+  record(TRACE_EVENT_RESET, allocator, ptr, size);
+}
+
+static void write_string(const char* str) {
+  fputc('"', s_file);
+  for (const char* cur = str; *cur != 0; ++cur) {
+    const unsigned char c = (unsigned char)*cur;
+    if (c == '"' || c == '\\') {
+      fprintf(s_file, "\\%c", c);
+    }
+    else if (c < 0x20) {
+      fprintf(s_file, "\\u%04x", c);
+    }
+    else {
+      fputc(c, s_file);
+    }
+  }
+  fputc('"', s_file);
+}
+
+static void begin_event() {
+  if (!s_first_event) {
+    fputs(",\n", s_file);
+  }
+  s_first_event = false;
+}
+
+static void write_event(const trace_event_t* event, uint64_t thread_id) {
+  static const char* const names[] = {"alloc", "free", "reset"};
+  begin_event();
+  fprintf(s_file,
+          "{\"name\":\"%s\",\"cat\":\"frag\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%" PRIu64 ".%03u,\"pid\":1,\"tid\":%" PRIu64 ",\"args\":{\"allocator\":",
+          names[event->type],
+          event->time_nsec / 1000,
+          (unsigned int)(event->time_nsec % 1000),
+          thread_id);
+  write_string(event->allocator_name);
+  fprintf(s_file, ",\"ptr\":\"0x%" PRIxPTR "\",\"size\":%zu}}", (uintptr_t)event->ptr, event->size);
+}
+
+// Writes out everything buffered so far and frees the rings of threads that have exited. Must hold s_writer_mutex.
+static void drain() {
+  if (s_file == NULL) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(s_rings_mutex);
+  trace_ring_t** link = &s_rings;
+  while (*link != nullptr) {
+    trace_ring_t* ring = *link;
+    const bool retired = ring->retired.load(std::memory_order_acquire);
+    const uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    for (; tail != head; ++tail) {
+      write_event(ring->events + (tail & (TRACE_RING_CAPACITY - 1)), ring->thread_id);
+    }
+    ring->tail.store(tail, std::memory_order_release);
+
+    if (retired) {
+      s_dropped += ring->dropped.load(std::memory_order_relaxed);
+      *link = ring->next;
+      ring->~trace_ring_t();
+      vm_release(ring, ring_size_bytes());
+    }
+    else {
+      link = &ring->next;
+    }
+  }
+}
+
+static void write_counter(frag_allocator_t* allocator, void* user_data) {
+  const uint64_t time_nsec = *(const uint64_t*)user_data;
+  frag_allocator_stats_t stats;
+  frag_allocator_stats(allocator, &stats);
+
+  begin_event();
+  fputs("{\"name\":", s_file);
+  write_string(allocator->name);
+  fprintf(s_file,
+          ",\"cat\":\"frag\",\"ph\":\"C\",\"ts\":%" PRIu64 ".%03u,\"pid\":1,\"args\":{\"bytes\":%zu,\"count\":%zu}}",
+          time_nsec / 1000,
+          (unsigned int)(time_nsec % 1000),
+          stats.bytes,
+          stats.count);
+}
+
+// Writes a counter sample for every allocator. Must hold s_writer_mutex.
+static void write_counters() {
+  uint64_t time_nsec = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_start_time).count();
+  registry_for_each(&write_counter, &time_nsec);
+
+  uint64_t dropped = s_dropped;
+  {
+    std::lock_guard<std::mutex> lock(s_rings_mutex);
+    for (trace_ring_t* ring = s_rings; ring != nullptr; ring = ring->next) {
+      dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+  }
+  begin_event();
+  fprintf(s_file,
+          "{\"name\":\"frag dropped events\",\"cat\":\"frag\",\"ph\":\"C\",\"ts\":%" PRIu64 ".%03u,\"pid\":1,\"args\":{\"count\":%" PRIu64 "}}",
+          time_nsec / 1000,
+          (unsigned int)(time_nsec % 1000),
+          dropped);
+}
+
+static void writer_main() {
+  auto next_counters = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(s_thread_mutex);
+  while (!s_thread_stop) {
+    s_thread_cond.wait_for(lock, std::chrono::milliseconds(TRACE_DRAIN_INTERVAL_MSEC));
+    lock.unlock();
+    {
+      std::lock_guard<std::mutex> writer_lock(s_writer_mutex);
+      drain();
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= next_counters) {
+        write_counters();
+        next_counters = now + std::chrono::milliseconds(s_counter_interval_msec);
+      }
+    }
+    lock.lock();
+  }
+}
+
+void trace_allocator_shutdown(const frag_allocator_t* allocator) {
+  if (!s_enabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  // events only point at the allocator's name, so they have to be written out before it goes away
+  std::lock_guard<std::mutex> writer_lock(s_writer_mutex);
+  drain();
+}
+
+void trace_shutdown() {
+  frag_trace_stop();
+}
+
+bool frag_trace_start(const char* path, unsigned int counter_interval_msec) {
+  std::lock_guard<std::mutex> writer_lock(s_writer_mutex);
+  if (!frag_assert(s_file == NULL, "a trace is already running")) {
+    return false;
+  }
+  s_file = fopen(path, "w");
+  if (s_file == NULL) {
+    return false;
+  }
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", s_file);
+  s_first_event = true;
+
+  // throw away anything left over from a previous trace
+  {
+    std::lock_guard<std::mutex> lock(s_rings_mutex);
+    for (trace_ring_t* ring = s_rings; ring != nullptr; ring = ring->next) {
+      ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+      ring->dropped.store(0, std::memory_order_relaxed);
+    }
+    s_dropped = 0;
+  }
+
+  s_start_time = std::chrono::steady_clock::now();
+  s_counter_interval_msec = counter_interval_msec;
+  s_thread_stop = false;
+  s_thread = std::thread(&writer_main);
+  s_enabled.store(true);
+  return true;
+}
+
+void frag_trace_stop() {
+  {
+    std::lock_guard<std::mutex> writer_lock(s_writer_mutex);
+    if (s_file == NULL) {
+      return;
+    }
+  }
+  s_enabled.store(false);
+
+  {
+    std::lock_guard<std::mutex> lock(s_thread_mutex);
+    s_thread_stop = true;
+  }
+  s_thread_cond.notify_one();
+  s_thread.join();
+
+  std::lock_guard<std::mutex> writer_lock(s_writer_mutex);
+  drain();
+  write_counters();
+  fputs("\n]}\n", s_file);
+  fclose(s_file);
+  s_file = NULL;
+}
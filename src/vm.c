@@ -0,0 +1,41 @@
+#include <sys/mman.h>
+#include <unistd.h>
+#include "internal.h"
+
+size_t vm_page_size() {
+  static size_t s_page_size = 0;
+  if (s_page_size == 0) {
+    s_page_size = (size_t)sysconf(_SC_PAGESIZE);
+  }
+  return s_page_size;
+}
+
+void* vm_reserve(size_t size) {
+  int flags = MAP_PRIVATE | MAP_ANON;
+#ifdef MAP_NORESERVE
+  flags |= MAP_NORESERVE;
+#endif
+  void* ptr = mmap(NULL, size, PROT_NONE, flags, -1, 0);
+  if (ptr == MAP_FAILED) {
+    return NULL;
+  }
+  return ptr;
+}
+
+bool vm_commit(void* ptr, size_t size) {
+  return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+void vm_decommit(void* ptr, size_t size) {
+  // mapping fresh pages over the range drops the physical memory and guarantees the pages read back as zero once they
+  // are committed again
+  int flags = MAP_PRIVATE | MAP_ANON | MAP_FIXED;
+#ifdef MAP_NORESERVE
+  flags |= MAP_NORESERVE;
+#endif
+  mmap(ptr, size, PROT_NONE, flags, -1, 0);
+}
+
+void vm_release(void* ptr, size_t size) {
+  munmap(ptr, size);
+}
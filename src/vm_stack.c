@@ -0,0 +1,180 @@
+#include <string.h>
+#include "internal.h"
+
+// the minimum amount of memory to commit at a time so growing doesn't hit the OS for every page
+#define VM_STACK_COMMIT_GRANULARITY_BYTES (64 * 1024)
+
+typedef struct vm_stack_allocator_impl_t {
+  // spans the entire reserved range
+  bump_stack_t stack;
+
+  // the end of the committed pages (everything from stack.beg up to here is usable)
+  char* committed;
+
+  // the highest address that has been handed out since its pages were committed (everything above is still zero)
+  char* dirty;
+
+  // how much committed memory to keep above the top of the stack when freeing
+  size_t decommit_slack;
+} vm_stack_allocator_impl_t;
+
+static char* page_align_up(const vm_stack_allocator_impl_t* impl, char* ptr, size_t extra) {
+  // clamp to the reserved range so huge values (e.g. SIZE_MAX) don't overflow
+  const size_t remaining = (size_t)(impl->stack.end - ptr);
+  if (extra >= remaining) {
+    return impl->stack.end;
+  }
+  return (char*)align_up_with_offset_ptr(ptr, vm_page_size(), extra);
+}
+
+static size_t decommit_above(vm_stack_allocator_impl_t* impl, char* keep_end, size_t max_release_bytes) {
+  if (impl->committed <= keep_end) {
+    return 0;
+  }
+
+  // release from the top down so a partial release still leaves the committed range contiguous
+  size_t size = (size_t)(impl->committed - keep_end);
+  if (size > max_release_bytes) {
+    size = max_release_bytes & ~(vm_page_size() - 1);
+    if (size == 0) {
+      return 0;
+    }
+  }
+  char* beg = impl->committed - size;
+  vm_decommit(beg, size);
+  impl->committed = beg;
+  if (impl->dirty > beg) {
+    impl->dirty = beg;
+  }
+  return size;
+}
+
+static bool commit_up_to(vm_stack_allocator_impl_t* impl, char* end) {
+  if (end <= impl->committed) {
+    return true;
+  }
+  char* commit_end = page_align_up(impl, end, 0);
+  if ((size_t)(commit_end - impl->committed) < VM_STACK_COMMIT_GRANULARITY_BYTES) {
+    commit_end = page_align_up(impl, impl->committed, VM_STACK_COMMIT_GRANULARITY_BYTES);
+  }
+  if (!vm_commit(impl->committed, (size_t)(commit_end - impl->committed))) {
+    return false;
+  }
+  impl->committed = commit_end;
+  return true;
+}
+
+static size_t vm_stack_get_size(const frag_allocator_t* allocator, void* ptr) {
+  const vm_stack_allocator_impl_t* impl = (const vm_stack_allocator_impl_t*)allocator->impl;
+  return bump_stack_get_size(&impl->stack, ptr);
+}
+
+static void* vm_stack_alloc(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  vm_stack_allocator_impl_t* impl = (vm_stack_allocator_impl_t*)allocator->impl;
+
+  // make sure the pages are committed before the stack writes the allocation header
+  char* alloc_end = bump_stack_alloc_end(&impl->stack, size, alignment);
+  if (alloc_end > impl->stack.end) {
+    *size_allocated = 0;
+    return NULL;
+  }
+  if (!commit_up_to(impl, alloc_end)) {
+    *size_allocated = 0;
+    return NULL;
+  }
+
+  void* ptr = bump_stack_alloc(&impl->stack, size, alignment, size_allocated);
+  if (alloc_end > impl->dirty) {
+    impl->dirty = alloc_end;
+  }
+  return ptr;
+}
+
+static void* vm_stack_alloc_zero(frag_allocator_t* allocator, size_t size, size_t alignment, const char* file, int line, const char* func, size_t* size_allocated) {
+  vm_stack_allocator_impl_t* impl = (vm_stack_allocator_impl_t*)allocator->impl;
+
+  // only the part of the allocation that overlaps memory we've handed out before needs to be cleared
+  char* dirty = impl->dirty;
+  char* ptr = (char*)vm_stack_alloc(allocator, size, alignment, file, line, func, size_allocated);
+  if (ptr != NULL && ptr < dirty) {
+    const size_t dirty_size = (size_t)(dirty - ptr);
+    memset(ptr, 0, dirty_size < size ? dirty_size : size);
+  }
+  return ptr;
+}
+
+static void vm_stack_free(frag_allocator_t* allocator, void* ptr, const char* file, int line, const char* func) {
+  vm_stack_allocator_impl_t* impl = (vm_stack_allocator_impl_t*)allocator->impl;
+  bump_stack_free(&impl->stack, ptr);
+  if (impl->decommit_slack != SIZE_MAX) {
+    decommit_above(impl, page_align_up(impl, impl->stack.cur, impl->decommit_slack), SIZE_MAX);
+  }
+}
+
+static bool vm_stack_resize(frag_allocator_t* allocator, void* ptr, size_t size, size_t* size_allocated_before, size_t* size_allocated) {
+  vm_stack_allocator_impl_t* impl = (vm_stack_allocator_impl_t*)allocator->impl;
+  if (!bump_stack_is_top(&impl->stack, ptr) || size > (size_t)(impl->stack.end - (char*)ptr) || !commit_up_to(impl, (char*)ptr + size)) {
+    return false;
+  }
+  if (!bump_stack_resize(&impl->stack, ptr, size, size_allocated_before, size_allocated)) {
+    return false;
+  }
+  if (impl->stack.cur > impl->dirty) {
+    impl->dirty = impl->stack.cur;
+  }
+  return true;
+}
+
+static size_t vm_stack_usable_size(const frag_allocator_t* allocator, void* ptr) {
+  return bump_stack_usable_size(ptr);
+}
+
+static void vm_stack_query_layout(const frag_allocator_t* allocator, frag_allocator_layout_t* layout) {
+  // only the committed pages count, the rest of the reservation costs nothing until it's needed
+  const vm_stack_allocator_impl_t* impl = (const vm_stack_allocator_impl_t*)allocator->impl;
+  bump_stack_query_layout(&impl->stack, impl->committed, layout);
+}
+
+static void vm_stack_shutdown(frag_allocator_t* allocator) {
+  vm_stack_allocator_impl_t* impl = (vm_stack_allocator_impl_t*)allocator->impl;
+  vm_release(impl->stack.beg, (size_t)(impl->stack.end - impl->stack.beg));
+}
+
+static size_t vm_stack_trim(frag_allocator_t* allocator, size_t keep_bytes, size_t max_release_bytes) {
+  vm_stack_allocator_impl_t* impl = (vm_stack_allocator_impl_t*)allocator->impl;
+  return decommit_above(impl, page_align_up(impl, impl->stack.cur, keep_bytes), max_release_bytes);
+}
+
+frag_allocator_t* vm_stack_create(frag_allocator_t* owner, const char* name, bool needs_lock, size_t reserve_size, size_t decommit_slack) {
+  const size_t page_size = vm_page_size();
+  reserve_size = (reserve_size + page_size - 1) & ~(page_size - 1);
+  char* buf = (char*)vm_reserve(reserve_size);
+  if (!frag_assert(buf != NULL, "failed to reserve address space")) {
+    return NULL;
+  }
+
+  frag_allocator_desc_t desc = {0};
+  desc.name = name;
+  desc.needs_lock = needs_lock;
+  desc.alloc = &vm_stack_alloc;
+  desc.free = &vm_stack_free;
+  desc.get_size = &vm_stack_get_size;
+  desc.shutdown = &vm_stack_shutdown;
+  desc.trim = &vm_stack_trim;
+  desc.alloc_zero = &vm_stack_alloc_zero;
+  desc.resize = &vm_stack_resize;
+  desc.usable_size = &vm_stack_usable_size;
+  desc.query_layout = &vm_stack_query_layout;
+  desc.impl_size_bytes = sizeof(vm_stack_allocator_impl_t);
+  frag_allocator_t* allocator = allocator_create(owner, &desc);
+
+  vm_stack_allocator_impl_t* impl = (vm_stack_allocator_impl_t*)allocator->impl;
+  impl->stack.beg = buf;
+  impl->stack.end = buf + reserve_size;
+  impl->stack.cur = buf;
+  impl->committed = buf;
+  impl->dirty = buf;
+  impl->decommit_slack = decommit_slack;
+
+  return allocator;
+}